@@ -0,0 +1,136 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <immintrin.h>
+
+// Cache-line transfer bandwidth between two cores.
+// The producer (role 0) writes bw_size bytes, optionally with non-temporal
+// stores, and publishes the round number in ctrl->seq; the consumer
+// (role 1) reads every line and acknowledges in ctrl->ack. The producer
+// only rewrites the buffer after the ack, so each round moves the whole
+// buffer from one core to the other once.
+
+#define BW_WARMUP_ROUNDS 2
+#define BW_TARGET_BYTES (16ULL << 20)   // aim for ~16 MB per pair and direction
+#define BW_MIN_ROUNDS 100
+#define BW_MAX_ROUNDS 20000
+
+size_t bw_size;             // bytes per transfer, 0 = bandwidth mode off
+int bw_nontemporal;
+
+typedef struct {
+    volatile uint64_t seq __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint64_t ack __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint64_t sink __attribute__((aligned(CACHE_LINE_SIZE)));
+} bw_ctrl_t;
+
+static void fill_buffer(uint64_t *buf, size_t words, uint64_t v) {
+    if (bw_nontemporal) {
+        for (size_t i = 0; i < words; i++) {
+            _mm_stream_si64((long long *)&buf[i], (long long)v);
+        }
+        _mm_sfence();
+    } else {
+        for (size_t i = 0; i < words; i++) {
+            buf[i] = v;
+        }
+    }
+}
+
+static uint64_t read_buffer(const uint64_t *buf, size_t words) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < words; i++) {
+        sum += buf[i];
+    }
+    return sum;
+}
+
+static void producer(bw_t *bw) {
+    bw_ctrl_t *ctrl = bw->ctrl;
+    size_t words = bw_size / sizeof(uint64_t);
+    int total = BW_WARMUP_ROUNDS + bw->rounds;
+    uint64_t start = 0;
+
+    for (int r = 1; r <= total; r++) {
+        if (r == BW_WARMUP_ROUNDS + 1) start = rdtsc_start();
+        fill_buffer(bw->buf, words, r);
+        __atomic_store_n(&ctrl->seq, r, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&ctrl->ack, __ATOMIC_ACQUIRE) != (uint64_t)r) cpu_relax();
+    }
+    bw->res->bw_cycles = rdtsc_end() - start;
+    bw->res->bw_rounds = bw->rounds;
+}
+
+static void consumer(bw_t *bw) {
+    bw_ctrl_t *ctrl = bw->ctrl;
+    size_t words = bw_size / sizeof(uint64_t);
+    int total = BW_WARMUP_ROUNDS + bw->rounds;
+    uint64_t sum = 0;
+
+    for (int r = 1; r <= total; r++) {
+        while (__atomic_load_n(&ctrl->seq, __ATOMIC_ACQUIRE) != (uint64_t)r) cpu_relax();
+        sum += read_buffer(bw->buf, words);
+        __atomic_store_n(&ctrl->ack, r, __ATOMIC_RELEASE);
+    }
+    ctrl->sink = sum;   // keep the reads
+}
+
+static void bw_job(pool_job_t *job, int role) {
+    bw_t *bw = (bw_t *)job;
+    if (role == 0) {
+        // First touch from the producer places the buffer on its node
+        memset(bw->buf, 0, bw_size);
+    }
+    job_sync(job);
+    if (role == 0) producer(bw);
+    else consumer(bw);
+}
+
+// Start a src -> dst transfer on the worker pool. Returns -1 if either CPU
+// has no pinned worker.
+int bw_start(bw_t *bw, int src, int dst, pair_result_t *res) {
+    bw->buf = aligned_alloc(CACHE_LINE_SIZE, bw_size);
+    bw->ctrl = aligned_alloc(CACHE_LINE_SIZE, sizeof(bw_ctrl_t));
+    if (!bw->buf || !bw->ctrl) { perror("malloc"); exit(1); }
+    memset(bw->ctrl, 0, sizeof(bw_ctrl_t));
+
+    uint64_t rounds = BW_TARGET_BYTES / bw_size;
+    if (rounds < BW_MIN_ROUNDS) rounds = BW_MIN_ROUNDS;
+    if (rounds > BW_MAX_ROUNDS) rounds = BW_MAX_ROUNDS;
+    bw->rounds = rounds;
+    bw->res = res;
+    res->bw_cycles = 0;
+    res->bw_rounds = 0;
+
+    bw->job.fn = bw_job;
+    bw->job.nthreads = 2;
+    int cpus[2] = {src, dst};
+    if (pool_dispatch(&bw->job, cpus) != 0) {
+        free(bw->buf);
+        free(bw->ctrl);
+        bw->buf = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void bw_finish(bw_t *bw) {
+    if (!bw->buf) return;
+    pool_wait(&bw->job);
+    free(bw->buf);
+    free(bw->ctrl);
+    bw->buf = NULL;
+}
+
+int run_bandwidth(int src, int dst, pair_result_t *res) {
+    bw_t bw;
+    if (bw_start(&bw, src, dst, res) != 0) return -1;
+    bw_finish(&bw);
+    return 0;
+}
+
+// Bytes per second delivered, 0 if the pair was not measured
+double bw_gbps(const pair_result_t *res) {
+    if (res->bw_cycles == 0) return 0;
+    double sec = res->bw_cycles / tsc_hz;
+    return (double)bw_size * res->bw_rounds / sec / 1e9;
+}
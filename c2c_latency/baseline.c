@@ -0,0 +1,462 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <math.h>
+
+// Baseline comparison (--baseline).
+// Loads a result written by --json and compares the fresh matrix with it
+// cell by cell. A cell changed if the two-sample KS test on the recorded
+// histograms rejects equality at KS_ALPHA *and* its median moved by more
+// than the threshold: with thousands of samples KS alone flags shifts far
+// too small to matter. Tiers are compared on the median of their cells'
+// medians. Everything is compared in ns, so runs on hosts whose TSC
+// frequency differs still line up.
+
+#define KS_ALPHA 0.001
+#define KS_C 1.949              // sqrt(-ln(KS_ALPHA / 2) / 2)
+
+// Minimal JSON reader, enough for files written by write_json()
+typedef enum { JSON_NULL, JSON_BOOL, JSON_NUM, JSON_STR, JSON_ARR, JSON_OBJ } json_type_t;
+
+typedef struct json {
+    json_type_t type;
+    double num;                 // JSON_NUM, JSON_BOOL
+    char *str;                  // JSON_STR
+    char *key;                  // member name inside an object
+    struct json *child;         // first element or member
+    struct json *next;
+} json_t;
+
+typedef struct {
+    const char *p;
+    int depth;
+} json_parser_t;
+
+static json_t *json_value(json_parser_t *jp);
+
+static void json_free(json_t *j) {
+    while (j) {
+        json_t *next = j->next;
+        json_free(j->child);
+        free(j->str);
+        free(j->key);
+        free(j);
+        j = next;
+    }
+}
+
+static void json_skip(json_parser_t *jp) {
+    while (*jp->p == ' ' || *jp->p == '\t' || *jp->p == '\n' || *jp->p == '\r') jp->p++;
+}
+
+// String body after the opening quote. \uXXXX escapes outside ASCII are
+// replaced by '?': nothing written by write_json() needs them.
+static char *json_string(json_parser_t *jp) {
+    size_t cap = 32, len = 0;
+    char *s = malloc(cap);
+    while (s && *jp->p && *jp->p != '"') {
+        char c = *jp->p++;
+        if (c == '\\') {
+            c = *jp->p++;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': {
+                    unsigned v;
+                    if (sscanf(jp->p, "%4x", &v) != 1) { free(s); return NULL; }
+                    jp->p += 4;
+                    c = v < 0x80 ? (char)v : '?';
+                    break;
+                }
+                case '\0': free(s); return NULL;
+                default: break;     // \" \\ \/
+            }
+        }
+        if (len + 1 == cap) {
+            char *bigger = realloc(s, cap *= 2);
+            if (!bigger) { free(s); return NULL; }
+            s = bigger;
+        }
+        s[len++] = c;
+    }
+    if (!s || *jp->p != '"') { free(s); return NULL; }
+    jp->p++;
+    s[len] = '\0';
+    return s;
+}
+
+// Elements of an array or members of an object up to the closing bracket
+static int json_items(json_parser_t *jp, json_t *parent, char close) {
+    json_t **tail = &parent->child;
+    json_skip(jp);
+    if (*jp->p == close) { jp->p++; return 0; }
+    for (;;) {
+        char *key = NULL;
+        json_skip(jp);
+        if (close == '}') {
+            if (*jp->p != '"') return -1;
+            jp->p++;
+            if (!(key = json_string(jp))) return -1;
+            json_skip(jp);
+            if (*jp->p != ':') { free(key); return -1; }
+            jp->p++;
+        }
+        json_t *item = json_value(jp);
+        if (!item) { free(key); return -1; }
+        item->key = key;
+        *tail = item;
+        tail = &item->next;
+
+        json_skip(jp);
+        if (*jp->p == ',') { jp->p++; continue; }
+        if (*jp->p != close) return -1;
+        jp->p++;
+        return 0;
+    }
+}
+
+static json_t *json_value(json_parser_t *jp) {
+    json_skip(jp);
+    if (jp->depth > 64) return NULL;
+    json_t *j = calloc(1, sizeof(json_t));
+    if (!j) return NULL;
+    char c = *jp->p;
+    int ok = 1;
+
+    if (c == '{' || c == '[') {
+        jp->p++;
+        jp->depth++;
+        j->type = c == '{' ? JSON_OBJ : JSON_ARR;
+        ok = json_items(jp, j, c == '{' ? '}' : ']') == 0;
+        jp->depth--;
+    } else if (c == '"') {
+        jp->p++;
+        j->type = JSON_STR;
+        ok = (j->str = json_string(jp)) != NULL;
+    } else if (strncmp(jp->p, "true", 4) == 0 || strncmp(jp->p, "false", 5) == 0) {
+        j->type = JSON_BOOL;
+        j->num = c == 't';
+        jp->p += c == 't' ? 4 : 5;
+    } else if (strncmp(jp->p, "null", 4) == 0) {
+        jp->p += 4;
+    } else {
+        char *end;
+        j->type = JSON_NUM;
+        j->num = strtod(jp->p, &end);
+        ok = end != jp->p;
+        jp->p = end;
+    }
+    if (!ok) { json_free(j); return NULL; }
+    return j;
+}
+
+static const json_t *json_get(const json_t *obj, const char *key) {
+    if (!obj || obj->type != JSON_OBJ) return NULL;
+    for (const json_t *m = obj->child; m; m = m->next) {
+        if (strcmp(m->key, key) == 0) return m;
+    }
+    return NULL;
+}
+
+static double json_num(const json_t *obj, const char *key, double dflt) {
+    const json_t *v = json_get(obj, key);
+    return v && v->type == JSON_NUM ? v->num : dflt;
+}
+
+static char *json_strdup(const json_t *obj, const char *key) {
+    const json_t *v = json_get(obj, key);
+    return strdup(v && v->type == JSON_STR ? v->str : "");
+}
+
+typedef struct {
+    int from, to;
+    int mirrored;               // half matrix: copy of the opposite direction
+    uint64_t n, min, max;
+    double sum;
+    int nbuckets;
+    uint32_t (*buckets)[2];     // bucket index, count
+} base_pair_t;
+
+struct baseline {
+    char *date, *hostname, *kernel, *cpu_model, *microcode, *governor, *pattern;
+    double tsc_hz, one_way;
+    int npairs;
+    base_pair_t *pairs;         // sorted by (from, to)
+};
+
+static int pair_cmp(const void *pa, const void *pb) {
+    const base_pair_t *a = pa, *b = pb;
+    if (a->from != b->from) return a->from - b->from;
+    return a->to - b->to;
+}
+
+void baseline_free(baseline_t *b) {
+    if (!b) return;
+    for (int i = 0; i < b->npairs; i++) free(b->pairs[i].buckets);
+    free(b->pairs);
+    free(b->date);
+    free(b->hostname);
+    free(b->kernel);
+    free(b->cpu_model);
+    free(b->microcode);
+    free(b->governor);
+    free(b->pattern);
+    free(b);
+}
+
+static int load_pair(const json_t *p, base_pair_t *bp) {
+    const json_t *hist = json_get(p, "hist");
+    const json_t *buckets = json_get(hist, "buckets");
+    if (!buckets || buckets->type != JSON_ARR) return -1;
+    bp->from = json_num(p, "from", -1);
+    bp->to = json_num(p, "to", -1);
+    const json_t *mirrored = json_get(p, "mirrored");
+    bp->mirrored = mirrored && mirrored->type == JSON_BOOL && mirrored->num != 0;
+    bp->n = json_num(hist, "n", 0);
+    bp->sum = json_num(hist, "sum", 0);
+    bp->min = json_num(hist, "min", 0);
+    bp->max = json_num(hist, "max", 0);
+
+    int count = 0;
+    for (const json_t *e = buckets->child; e; e = e->next) count++;
+    bp->buckets = malloc((count ? count : 1) * sizeof(*bp->buckets));
+    if (!bp->buckets) return -1;
+    bp->nbuckets = 0;
+    for (const json_t *e = buckets->child; e; e = e->next) {
+        const json_t *idx = e->child, *cnt = idx ? idx->next : NULL;
+        if (!cnt || idx->type != JSON_NUM || cnt->type != JSON_NUM ||
+            idx->num < 0 || idx->num >= HIST_BUCKETS) return -1;
+        bp->buckets[bp->nbuckets][0] = idx->num;
+        bp->buckets[bp->nbuckets][1] = cnt->num;
+        bp->nbuckets++;
+    }
+    return bp->from >= 0 && bp->to >= 0 && bp->n > 0 ? 0 : -1;
+}
+
+// Read a --json result (--baseline, --matrix). Returns NULL (after printing
+// why) on failure.
+baseline_t *baseline_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Cannot read %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    char *text = NULL;
+    size_t cap = 0;
+    ssize_t len = getdelim(&text, &cap, '\0', f);
+    fclose(f);
+    if (len <= 0) {
+        free(text);
+        fprintf(stderr, "%s is empty\n", path);
+        return NULL;
+    }
+
+    json_parser_t jp = {text, 0};
+    json_t *root = json_value(&jp);
+    free(text);
+    const json_t *pairs = json_get(root, "pairs");
+    if (!root || !pairs || pairs->type != JSON_ARR) {
+        fprintf(stderr, "%s is not a c2c_latency --json result\n", path);
+        json_free(root);
+        return NULL;
+    }
+
+    baseline_t *b = calloc(1, sizeof(baseline_t));
+    const json_t *host = json_get(root, "host"), *run = json_get(root, "run");
+    int count = 0;
+    for (const json_t *p = pairs->child; p; p = p->next) count++;
+    if (!b || !(b->pairs = calloc(count ? count : 1, sizeof(base_pair_t)))) {
+        perror("malloc");
+        exit(1);
+    }
+    b->date = json_strdup(root, "date");
+    b->hostname = json_strdup(host, "hostname");
+    b->kernel = json_strdup(host, "kernel");
+    b->cpu_model = json_strdup(host, "cpu_model");
+    b->microcode = json_strdup(host, "microcode");
+    b->governor = json_strdup(host, "governor");
+    b->pattern = json_strdup(run, "pattern");
+    b->tsc_hz = json_num(host, "tsc_hz", 0);
+    b->one_way = json_num(run, "one_way_scale", 0.5);
+
+    for (const json_t *p = pairs->child; p; p = p->next) {
+        if (load_pair(p, &b->pairs[b->npairs]) != 0) {
+            fprintf(stderr, "%s: malformed pair entry\n", path);
+            free(b->pairs[b->npairs].buckets);
+            json_free(root);
+            baseline_free(b);
+            return NULL;
+        }
+        b->npairs++;
+    }
+    json_free(root);
+    if (b->tsc_hz <= 0) {
+        fprintf(stderr, "%s has no TSC frequency\n", path);
+        baseline_free(b);
+        return NULL;
+    }
+    qsort(b->pairs, b->npairs, sizeof(base_pair_t), pair_cmp);
+    return b;
+}
+
+static void base_hist(const base_pair_t *bp, lat_hist_t *h) {
+    hist_init(h);
+    for (int k = 0; k < bp->nbuckets; k++) h->counts[bp->buckets[k][0]] = bp->buckets[k][1];
+    h->n = bp->n;
+    h->sum = bp->sum;
+    h->min = bp->min;
+    h->max = bp->max;
+}
+
+// p50 one-way latency from -> to in ns, -1 if the pair is not in the file
+double baseline_latency_ns(const baseline_t *b, int from, int to) {
+    base_pair_t key = {.from = from, .to = to};
+    const base_pair_t *bp = bsearch(&key, b->pairs, b->npairs, sizeof(base_pair_t), pair_cmp);
+    if (!bp) return -1;
+    lat_hist_t *h = malloc(sizeof(lat_hist_t));
+    if (!h) { perror("malloc"); exit(1); }
+    base_hist(bp, h);
+    double ns = hist_percentile(h, 50.0) * b->one_way * 1e9 / b->tsc_hz;
+    free(h);
+    return ns;
+}
+
+static void fingerprint_diff(const char *what, const char *then, const char *now, int *any) {
+    if (strcmp(then, now ? now : "") == 0) return;
+    if (!(*any)++) printf("Changed since the baseline:\n");
+    printf("  %-10s %s -> %s\n", what, then, now ? now : "");
+}
+
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static double median(double *v, int n) {
+    if (n == 0) return 0;
+    qsort(v, n, sizeof(double), compare_double);
+    return n & 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// Baseline pair from -> to if it was measured (not mirrored), else NULL
+static const base_pair_t *base_measured(const baseline_t *b, int from, int to) {
+    base_pair_t key = {.from = from, .to = to};
+    const base_pair_t *bp = bsearch(&key, b->pairs, b->npairs, sizeof(base_pair_t), pair_cmp);
+    return bp && !bp->mirrored ? bp : NULL;
+}
+
+static const pair_result_t *now_measured(const matrix_out_t *m, int i, int j) {
+    const pair_result_t *r = &m->res[i * m->n + j];
+    return r->hist.n && !r->mirrored ? r : NULL;
+}
+
+// Compare the measured matrix with the baseline and print changed cells and
+// the per-tier summary. Returns the number of regressions (cells plus
+// tiers) beyond threshold_pct, or -1 if the runs cannot be compared.
+int baseline_compare(const baseline_t *b, const matrix_out_t *m, double threshold_pct) {
+    host_info_t h;
+    host_info(&h, m->cpus[0]);
+    printf("\nBaseline: %s, %s, kernel %s, microcode %s\n", b->date, b->hostname, b->kernel,
+           b->microcode);
+    int any = 0;
+    fingerprint_diff("host", b->hostname, h.hostname, &any);
+    fingerprint_diff("kernel", b->kernel, h.uts.release, &any);
+    fingerprint_diff("CPU", b->cpu_model, h.cpu_model, &any);
+    fingerprint_diff("microcode", b->microcode, h.microcode, &any);
+    fingerprint_diff("governor", b->governor, h.governor, &any);
+    fingerprint_diff("pattern", b->pattern, m->pattern, &any);
+    host_free(&h);
+    if (strcmp(b->pattern, m->pattern) != 0 || b->one_way != m->one_way) {
+        fprintf(stderr, "Baseline was measured with pattern '%s', this run uses '%s': "
+                "not comparable\n", b->pattern, m->pattern);
+        return -1;
+    }
+
+    int n = m->n;
+    double base_scale = b->one_way * 1e9 / b->tsc_hz;
+    double now_scale = m->one_way * 1e9 / tsc_hz;
+    double *base_p50[NUM_TIERS], *now_p50[NUM_TIERS];
+    int tier_pairs[NUM_TIERS] = {0}, tier_up[NUM_TIERS] = {0}, tier_down[NUM_TIERS] = {0};
+    for (int t = 0; t < NUM_TIERS; t++) {
+        base_p50[t] = malloc((size_t)n * n * sizeof(double));
+        now_p50[t] = malloc((size_t)n * n * sizeof(double));
+        if (!base_p50[t] || !now_p50[t]) { perror("malloc"); exit(1); }
+    }
+    lat_hist_t *bh = malloc(sizeof(lat_hist_t));
+    if (!bh) { perror("malloc"); exit(1); }
+
+    // One comparison per unordered pair. A half matrix measures only one
+    // direction and mirrors it, and which one depends on the sweep and the
+    // CPU order, so the two runs may have measured opposite directions.
+    // Prefer the same direction, else pair whatever each run measured.
+    int compared = 0, regressed = 0, improved = 0, changed = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            const pair_result_t *rij = now_measured(m, i, j), *rji = now_measured(m, j, i);
+            const base_pair_t *bij = base_measured(b, m->cpus[i], m->cpus[j]);
+            const base_pair_t *bji = base_measured(b, m->cpus[j], m->cpus[i]);
+            const pair_result_t *r;
+            const base_pair_t *bp;
+            int from = i, to = j;
+            if (rij && bij) { r = rij; bp = bij; }
+            else if (rji && bji) { r = rji; bp = bji; from = j; to = i; }
+            else {
+                r = rij ? rij : rji;
+                bp = bij ? bij : bji;
+                if (!r || !bp) continue;
+                if (r == rji) { from = j; to = i; }
+            }
+            base_hist(bp, bh);
+
+            double then = hist_percentile(bh, 50.0) * base_scale;
+            double now = hist_percentile(&r->hist, 50.0) * now_scale;
+            double shift = then > 0 ? (now - then) / then * 100 : 0;
+            double d = hist_ks_distance(bh, base_scale, &r->hist, now_scale);
+            double crit = KS_C * sqrt((double)(bh->n + r->hist.n) / ((double)bh->n * r->hist.n));
+            int sig = d > crit && fabs(shift) > threshold_pct;
+
+            tier_t t = topo_tier(m->cpus[from], m->cpus[to]);
+            base_p50[t][tier_pairs[t]] = then;
+            now_p50[t][tier_pairs[t]++] = now;
+            compared++;
+            if (!sig) continue;
+            if (shift > 0) { regressed++; tier_up[t]++; }
+            else { improved++; tier_down[t]++; }
+            if (!changed++) {
+                printf("Changed cells (p50 one-way ns, KS alpha %.3f, threshold %.1f%%):\n",
+                       KS_ALPHA, threshold_pct);
+                printf("   From -> To    Tier                   Baseline       Now   Change   KS D\n");
+            }
+            printf("  %5d -> %-5d %-22s %8.1f  %8.1f  %+6.1f%%  %5.3f\n", m->cpus[from],
+                   m->cpus[to], tier_name(t), then, now, shift, d);
+        }
+    }
+    free(bh);
+
+    int tiers_regressed = 0;
+    printf("Tier                    Pairs  Baseline p50   Now p50   Change  Regressed  Improved\n");
+    for (int t = 0; t < NUM_TIERS; t++) {
+        if (!tier_pairs[t]) continue;
+        double then = median(base_p50[t], tier_pairs[t]);
+        double now = median(now_p50[t], tier_pairs[t]);
+        double shift = then > 0 ? (now - then) / then * 100 : 0;
+        int worse = shift > threshold_pct && tier_up[t] > 0;
+        tiers_regressed += worse;
+        printf("%-22s %6d %10.1f ns %7.1f ns %+7.1f%% %9d %9d%s\n", tier_name(t), tier_pairs[t],
+               then, now, shift, tier_up[t], tier_down[t], worse ? "  REGRESSED" : "");
+    }
+    for (int t = 0; t < NUM_TIERS; t++) {
+        free(base_p50[t]);
+        free(now_p50[t]);
+    }
+
+    if (compared == 0) {
+        fprintf(stderr, "No pair of this run is in the baseline, nothing compared\n");
+        return -1;
+    }
+    printf("Baseline comparison: %d pairs, %d regressed, %d improved, %d tier%s regressed\n",
+           compared, regressed, improved, tiers_regressed, tiers_regressed == 1 ? "" : "s");
+    return regressed + tiers_regressed;
+}
@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+
+// One writer, many readers on the same line.
+// The writer stores a TSC stamp and a sequence number into one line; every
+// other selected CPU polls that line and, on seeing the new sequence
+// number, records its own TSC minus the stamp, then acks on its own line.
+// The writer waits for all acks before the next store, so each round is
+// one broadcast of a freshly modified line to all readers at once.
+// Samples are one-way and compare TSCs of different cores, so they assume
+// a synchronized (invariant) TSC; any residual offset shows up as a bias.
+
+#define BCAST_ITERATIONS (ITERATIONS / 10 > 10 ? ITERATIONS / 10 : 10)
+#define BCAST_WARMUP (BCAST_ITERATIONS / 10)
+
+typedef struct {
+    volatile uint64_t seq;
+    volatile uint64_t stamp;
+} __attribute__((aligned(CACHE_LINE_SIZE))) bcast_line_t;
+
+typedef struct {
+    volatile uint64_t seq;
+} __attribute__((aligned(CACHE_LINE_SIZE))) bcast_ack_t;
+
+typedef struct {
+    pool_job_t job;
+    bcast_line_t *line;
+    bcast_ack_t *acks;          // per role, [0] unused
+    pair_result_t **res;        // per role, [0] unused
+} bcast_t;
+
+static void bcast_job(pool_job_t *job, int role) {
+    bcast_t *bc = (bcast_t *)job;
+    bcast_line_t *line = bc->line;
+    int nthreads = job->nthreads;
+
+    job_sync(job);
+    for (uint64_t i = 1; i <= BCAST_WARMUP + BCAST_ITERATIONS; i++) {
+        if (role == 0) {
+            line->stamp = rdtsc_start();
+            line->seq = i;
+            for (int r = 1; r < nthreads; r++) {
+                while (bc->acks[r].seq != i);
+            }
+        } else {
+            while (line->seq != i);
+            uint64_t now = rdtsc_end();
+            int64_t delta = (int64_t)(now - line->stamp);
+            if (i > BCAST_WARMUP) hist_record(&bc->res[role]->hist, delta > 0 ? delta : 0);
+            bc->acks[role].seq = i;
+        }
+    }
+}
+
+// Broadcast from cpus[writer] to all other cpus; row[j] receives the
+// latency seen by cpus[j]. The line and the acks live on home (-1: first
+// touch). Returns -1 if a CPU has no pinned worker.
+int run_broadcast_row(const int *cpus, int n, int writer, int home, pair_result_t *row) {
+    bcast_t bc;
+    int *order = malloc(n * sizeof(int));
+    bc.res = malloc(n * sizeof(pair_result_t *));
+    bc.line = numa_alloc(sizeof(bcast_line_t), home, 0);
+    bc.acks = numa_alloc(n * sizeof(bcast_ack_t), home, 0);
+    if (!order || !bc.res || !bc.line || !bc.acks) { perror("malloc"); exit(1); }
+    memset(bc.line, 0, sizeof(bcast_line_t));
+    memset(bc.acks, 0, n * sizeof(bcast_ack_t));
+
+    // Role 0 writes, the others read in matrix order
+    order[0] = cpus[writer];
+    for (int j = 0, r = 1; j < n; j++) {
+        hist_init(&row[j].hist);
+        if (j == writer) continue;
+        order[r] = cpus[j];
+        bc.res[r++] = &row[j];
+    }
+
+    bc.job.fn = bcast_job;
+    bc.job.nthreads = n;
+    int ret = pool_dispatch(&bc.job, order);
+    if (ret == 0) pool_wait(&bc.job);
+
+    free(order);
+    free(bc.res);
+    numa_free(bc.line, sizeof(bcast_line_t));
+    numa_free(bc.acks, n * sizeof(bcast_ack_t));
+    return ret;
+}
@@ -1,23 +1,61 @@
 #define _GNU_SOURCE
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <unistd.h>
-#include <pthread.h>
-#include <sched.h>
-#include <string.h>
+#include "c2c_latency.h"
 #include <time.h>
 #include <getopt.h>
-#include <errno.h>
+#include <sys/resource.h>
 
-// Cache line size is typically 64 bytes. 
-// We align structures to avoid false sharing.
-#define CACHE_LINE_SIZE 64
-#define ITERATIONS 100000
+#ifndef WARMUP_ITERATIONS
+#define WARMUP_ITERATIONS 1000
+#endif
+
+// Histogram samples are round trips; reported latency is one-way.
+#define ONE_WAY 0.5
+
+// Round trips folded into one histogram sample (-B). 1 = every round trip.
+static int batch_size = 1;
+
+// Adaptive mode (-A): run batches of adapt_batch_len round trips until the
+// 95% confidence interval of the median is within +/- adapt_rel_err of it.
+// 0 = off, every pair runs one batch of ITERATIONS.
+static double adapt_rel_err = 0;
+static int adapt_batch_len = ITERATIONS / 10;
+static int adapt_min_batches = 5;
+static int adapt_max_batches = 100;
+
+// shared_data_t.flag values written by the leader after each batch
+#define FLAG_STOP UINT64_MAX
+
+// NUMA node whose memory backs shared_data_t (--home), -1 = first touch
+static int home_node = -1;
+
+// Noise detection (--noise): a pair is noisy if its two CPUs took more than
+// noise_max interrupts + softirqs (timer ticks and rescheduling IPIs not
+// counted), or its threads were preempted, while it was measured. Noisy
+// pairs are measured again up to noise_reruns times.
+static int noise_check;
+static int noise_max;
+static int noise_reruns;
+
+// Access pattern of the ping-pong (--pattern)
+static pattern_t pattern = PATTERN_STORE;
+static const char *pattern_names[NUM_PATTERNS] = {
+    "store", "load", "rfo", "cas", "xchg", "broadcast", "oneway"
+};
+static const char *pattern_desc[NUM_PATTERNS] = {
+    "store handoff on one line", "load after remote store", "store after remote load",
+    "CAS handoff", "xchg handoff", "broadcast to all readers",
+    "one-way latency from TSC stamps"
+};
 
 typedef struct {
     volatile uint64_t flag __attribute__((aligned(CACHE_LINE_SIZE)));
     volatile uint64_t turn __attribute__((aligned(CACHE_LINE_SIZE)));
+    // Two-line patterns: ping is written by the leader only, pong by the
+    // follower only
+    volatile uint64_t ping __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint64_t ping_tsc;     // oneway: leader's TSC when sending ping
+    volatile uint64_t pong __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint64_t pong_delta;   // oneway: follower's TSC on seeing ping - ping_tsc
     // Padding to ensure separate cache lines if the compiler packs aggressively
     char pad[CACHE_LINE_SIZE]; 
 } shared_data_t;
@@ -28,24 +66,36 @@ typedef struct {
     shared_data_t *data;
 } thread_args_t;
 
-// Helper to get RDTSC
-static inline uint64_t rdtsc(void) {
-    unsigned int lo, hi;
-    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-    return ((uint64_t)hi << 32) | lo;
-}
-
-// Function to pin thread to a core
-void pin_thread_to_core(int core_id) {
+// Function to pin thread to a core. Returns 0 on success.
+int pin_thread_to_core(int core_id) {
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
     CPU_SET(core_id, &cpuset);
 
     pthread_t current_thread = pthread_self();
-    if (pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset) != 0) {
-        fprintf(stderr, "Error calling pthread_setaffinity_np: %s\n", strerror(errno));
-        // We continue, but results might be noisy
+    int err = pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
+    if (err != 0) {
+        fprintf(stderr, "Error pinning to CPU %d: %s\n", core_id, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+// Parse a byte count with an optional K/M/G suffix (powers of 1024).
+// Returns 0 on a malformed value.
+size_t parse_size(const char *arg) {
+    char *end;
+    double v = strtod(arg, &end);
+    if (end == arg || v <= 0) return 0;
+    switch (*end) {
+        case 'k': case 'K': v *= 1024; end++; break;
+        case 'm': case 'M': v *= 1024 * 1024; end++; break;
+        case 'g': case 'G': v *= 1024.0 * 1024 * 1024; end++; break;
+        default: break;
     }
+    if (*end == 'B' || *end == 'b') end++;
+    if (*end != '\0') return 0;
+    return (size_t)v;
 }
 
 // Thread function
@@ -96,91 +146,1423 @@ void *ping_pong_thread(void *arg) {
 
 
 // Optimized Thread Functions for Measurement
+// A ping-pong between two pool workers: role 0 leads and times, role 1
+// follows. Both run WARMUP_ITERATIONS untimed round trips first so the
+// cores are awake and the line is hot when timing starts.
+//
+// Timed round trips come in batches. After each batch the leader decides
+// whether to go on and publishes the decision in data->flag (batch number
+// to continue, FLAG_STOP to finish); the follower waits for it between
+// batches. The first round trip after a decision is left untimed so the
+// follower's read of the flag does not land in a sample.
 typedef struct {
-    int cpu_to_pin;
+    pool_job_t job;
     shared_data_t *data;
-    uint64_t total_cycles;
-} measure_args_t;
+    int iterations;         // timed round trips per batch, a multiple of batch_size
+    int max_batches;
+    pair_result_t *res;     // leader only
+    lat_hist_t *batch_hist; // leader only: scratch for the current batch
+    double *medians;        // leader only: per-batch median round trip
+    uint64_t seq;           // leader only: round trips sent so far
+} pingpong_t;
 
-void *thread_leader(void *arg) {
-    measure_args_t *args = (measure_args_t *)arg;
-    pin_thread_to_core(args->cpu_to_pin);
-    shared_data_t *data = args->data;
-    
-    // Sync start
-    data->turn = 0;
-    
-    // Wait for follower to be ready? 
-    // We can rely on a separate flag or sleep.
-    // A simple nanosleep to let the other thread spin up is often sufficient for a benchmark tool.
-    struct timespec ts = {0, 1000000}; // 1ms
-    nanosleep(&ts, NULL);
-
-    uint64_t start = rdtsc();
-    for (int i = 0; i < ITERATIONS; i++) {
-        data->turn = 1;         // Signal other
-        while (data->turn == 1); // Wait for return
-    }
-    uint64_t end = rdtsc();
-    
-    args->total_cycles = end - start;
-    return NULL;
+// One round trip is ping_send() + ping_wait() on the leader and pong() on
+// the follower; seq counts round trips on both sides.
+//   store: both sides flip turn with plain stores (line bounces in M state)
+//   cas, xchg: as store, but the flip is a locked CAS / xchg
+//   load: the leader writes ping, the follower pong, each polls the other's
+//         line, so every transfer is a load of a line modified remotely
+//   rfo: like load, but only the leader's store (plus mfence) is timed; the
+//        follower holds the line in S, so the store pays for invalidating it
+//   oneway: like load, but the leader stamps each ping with its TSC and the
+//        follower returns its own TSC at arrival minus the stamp, i.e. the
+//        one-way latency plus the TSC offset between the two cores
+static inline void ping_send(shared_data_t *data, uint64_t seq) {
+    switch (pattern) {
+        case PATTERN_ONEWAY:
+            data->ping_tsc = rdtsc_start();
+            data->ping = seq;
+            break;
+        case PATTERN_LOAD:
+        case PATTERN_RFO:
+            data->ping = seq;
+            break;
+        case PATTERN_CAS:
+            __sync_bool_compare_and_swap(&data->turn, 0, 1);
+            break;
+        case PATTERN_XCHG:
+            __atomic_exchange_n(&data->turn, 1, __ATOMIC_SEQ_CST);
+            break;
+        default:
+            data->turn = 1;
+            break;
+    }
 }
 
-void *thread_follower(void *arg) {
-    measure_args_t *args = (measure_args_t *)arg;
-    pin_thread_to_core(args->cpu_to_pin);
-    shared_data_t *data = args->data;
-    
-    for (int i = 0; i < ITERATIONS; i++) {
-        while (data->turn == 0); // Wait for signal
-        data->turn = 0;          // Signal back
+static inline void ping_wait(shared_data_t *data, uint64_t seq) {
+    if (pattern == PATTERN_LOAD || pattern == PATTERN_RFO || pattern == PATTERN_ONEWAY) {
+        while (data->pong != seq);
+    } else {
+        while (data->turn == 1);
     }
-    return NULL;
 }
 
-double run_benchmark(int cpu1, int cpu2) {
-    pthread_t t1, t2;
-    shared_data_t *data = aligned_alloc(CACHE_LINE_SIZE, sizeof(shared_data_t));
-    if (!data) { perror("malloc"); return -1; }
-    memset(data, 0, sizeof(shared_data_t));
-    
-    measure_args_t args1 = {cpu1, data, 0};
-    measure_args_t args2 = {cpu2, data, 0};
-    
-    pthread_create(&t2, NULL, thread_follower, &args2); // Start follower first
-    pthread_create(&t1, NULL, thread_leader, &args1);
-    
-    pthread_join(t1, NULL);
-    pthread_join(t2, NULL);
-    
-    free(data);
-    
-    // total_cycles is for ITERATIONS round-trips.
-    // One round trip is (CPU1->CPU2 + CPU2->CPU1).
-    // We usually report one-way latency.
-    return (double)args1.total_cycles / (2.0 * ITERATIONS);
+static inline void pong(shared_data_t *data, uint64_t seq) {
+    switch (pattern) {
+        case PATTERN_ONEWAY: {
+            while (data->ping != seq);
+            // Stores stay in order (TSO): the leader sees the delta with pong
+            data->pong_delta = rdtsc_end() - data->ping_tsc;
+            data->pong = seq;
+            break;
+        }
+        case PATTERN_LOAD:
+        case PATTERN_RFO:
+            while (data->ping != seq);
+            data->pong = seq;
+            break;
+        case PATTERN_CAS:
+            while (data->turn == 0);
+            __sync_bool_compare_and_swap(&data->turn, 1, 0);
+            break;
+        case PATTERN_XCHG:
+            while (data->turn == 0);
+            __atomic_exchange_n(&data->turn, 0, __ATOMIC_SEQ_CST);
+            break;
+        default:
+            while (data->turn == 0);
+            data->turn = 0;
+            break;
+    }
+}
+
+static void timed_batch(pingpong_t *pp) {
+    shared_data_t *data = pp->data;
+    int samples = pp->iterations / batch_size;
+
+    if (pattern == PATTERN_RFO) {
+        // Time the store alone; the follower's ack puts the line back into
+        // its cache (shared) before the next one
+        for (int s = 0; s < pp->iterations; s++) {
+            uint64_t seq = ++pp->seq;
+            uint64_t start = rdtsc_start();
+            ping_send(data, seq);
+            __asm__ __volatile__("mfence" ::: "memory");
+            hist_record(pp->batch_hist, rdtsc_end() - start);
+            ping_wait(data, seq);
+        }
+        return;
+    }
+    if (pattern == PATTERN_ONEWAY) {
+        // A follower TSC behind the leader's by more than the latency gives
+        // a negative delta; it is recorded as 0
+        for (int s = 0; s < pp->iterations; s++) {
+            uint64_t seq = ++pp->seq;
+            ping_send(data, seq);
+            ping_wait(data, seq);
+            int64_t delta = (int64_t)data->pong_delta;
+            hist_record(pp->batch_hist, delta > 0 ? (uint64_t)delta : 0);
+        }
+        return;
+    }
+
+    // One timestamp per batch_size round trips. The next ping is sent before
+    // the sample is recorded, so the histogram update overlaps with the
+    // follower's half of the trip instead of adding to it. Only the batch's
+    // first and last reads are fenced; a serializing read between samples
+    // would sit on the critical path of every round trip.
+    uint64_t prev = rdtsc_start();
+    ping_send(data, ++pp->seq);             // Signal other
+    for (int s = 0; s < samples; s++) {
+        for (int k = 1; k < batch_size; k++) {
+            ping_wait(data, pp->seq);       // Wait for return
+            ping_send(data, ++pp->seq);
+        }
+        ping_wait(data, pp->seq);
+        int last = (s + 1 == samples);
+        uint64_t now = last ? rdtsc_end() : rdtsc_lap();
+        if (!last) ping_send(data, ++pp->seq);
+        hist_record(pp->batch_hist, (now - prev) / batch_size);
+        prev = now;
+    }
+}
+
+static void round_trip(pingpong_t *pp) {
+    ping_send(pp->data, ++pp->seq);
+    ping_wait(pp->data, pp->seq);
+}
+
+static void thread_leader(pingpong_t *pp) {
+    shared_data_t *data = pp->data;
+
+    perf_begin();
+    for (int i = 0; i < WARMUP_ITERATIONS; i++) {
+        round_trip(pp);
+    }
+    uint64_t seq0 = pp->seq;
+    perf_start();
+
+    for (int b = 0; ; b++) {
+        if (b > 0) round_trip(pp);
+        hist_init(pp->batch_hist);
+        timed_batch(pp);
+        hist_merge(&pp->res->hist, pp->batch_hist);
+        pp->medians[b] = hist_percentile(pp->batch_hist, 50.0);
+        pp->res->batches = b + 1;
+
+        int done = (b + 1 >= pp->max_batches);
+        if (!done && b + 1 >= adapt_min_batches) {
+            done = (median_ci_rel_err(pp->medians, b + 1) <= adapt_rel_err);
+        }
+        data->flag = done ? FLAG_STOP : (uint64_t)(b + 1);
+        if (done) break;
+    }
+    perf_end(&pp->res->perf[0], pp->seq - seq0);
+}
+
+static void thread_follower(pingpong_t *pp) {
+    shared_data_t *data = pp->data;
+    uint64_t seq = 0;
+
+    perf_begin();
+    for (int i = 0; i < WARMUP_ITERATIONS; i++) {
+        pong(data, ++seq);
+    }
+    perf_start();
+
+    for (uint64_t b = 0; ; b++) {
+        int total = pp->iterations + (b > 0);
+        for (int i = 0; i < total; i++) {
+            pong(data, ++seq);      // Wait for signal, signal back
+        }
+        uint64_t flag;
+        while ((flag = data->flag) == b) cpu_relax();
+        if (flag == FLAG_STOP) break;
+    }
+    perf_end(&pp->res->perf[1], seq - WARMUP_ITERATIONS);
+}
+
+static void pingpong_job(pool_job_t *job, int role) {
+    pingpong_t *pp = (pingpong_t *)job;
+    struct rusage ru0, ru1;
+    job_sync(job);
+    if (noise_check) getrusage(RUSAGE_THREAD, &ru0);
+    if (role == 0) thread_leader(pp);
+    else thread_follower(pp);
+    if (noise_check) {
+        getrusage(RUSAGE_THREAD, &ru1);
+        pp->res->noise_csw[role] = ru1.ru_nivcsw - ru0.ru_nivcsw;
+    }
+}
+
+// shared_data_t on home_node if set, else wherever first touch puts it
+static shared_data_t *shared_alloc(void) {
+    if (home_node < 0) return aligned_alloc(CACHE_LINE_SIZE, sizeof(shared_data_t));
+    return numa_alloc(sizeof(shared_data_t), home_node, 0);
+}
+
+static void shared_free(shared_data_t *data) {
+    if (home_node < 0) free(data);
+    else numa_free(data, sizeof(shared_data_t));
+}
+
+static void pingpong_free(pingpong_t *pp) {
+    shared_free(pp->data);
+    free(pp->batch_hist);
+    free(pp->medians);
+    pp->data = NULL;
+}
+
+// Start a cpu1 (leader) <-> cpu2 ping-pong on the worker pool.
+// Returns -1 if either CPU has no pinned worker.
+static int pingpong_start(pingpong_t *pp, int cpu1, int cpu2, pair_result_t *res) {
+    int len = adapt_rel_err > 0 ? adapt_batch_len : ITERATIONS;
+
+    pp->max_batches = adapt_rel_err > 0 ? adapt_max_batches : 1;
+    pp->data = shared_alloc();
+    pp->batch_hist = malloc(sizeof(lat_hist_t));
+    pp->medians = malloc(pp->max_batches * sizeof(double));
+    if (!pp->data || !pp->batch_hist || !pp->medians) { perror("malloc"); exit(1); }
+    memset(pp->data, 0, sizeof(shared_data_t));
+    hist_init(&res->hist);
+    res->batches = 0;
+    memset(res->perf, 0, sizeof(res->perf));
+    memset(res->noise_csw, 0, sizeof(res->noise_csw));
+
+    pp->job.fn = pingpong_job;
+    pp->job.nthreads = 2;
+    pp->iterations = len - len % batch_size;
+    pp->res = res;
+    pp->seq = 0;
+
+    int cpus[2] = {cpu1, cpu2};
+    if (pool_dispatch(&pp->job, cpus) != 0) {
+        pingpong_free(pp);
+        return -1;
+    }
+    return 0;
+}
+
+static void pingpong_finish(pingpong_t *pp) {
+    if (!pp->data) return;
+    pool_wait(&pp->job);
+    pingpong_free(pp);
+}
+
+// Ping-pong of all jobs at once, a -> b then b -> a. With --noise the
+// interrupts of both CPUs are sampled around each round and noisy jobs are
+// measured again. Returns -1 if some job could not be dispatched.
+static int measure_pingpong(pair_job_t *jobs, int count) {
+    pingpong_t *pp = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(pingpong_t));
+    pair_job_t *todo = malloc(count * sizeof(pair_job_t));
+    int *failed = calloc(count, sizeof(int));
+    if (!pp || !todo || !failed) { perror("malloc"); exit(1); }
+    memcpy(todo, jobs, count * sizeof(pair_job_t));
+    int ret = 0;
+
+    for (int attempt = 0; count > 0; attempt++) {
+        noise_snap_t *before = noise_check ? noise_snapshot() : NULL;
+        for (int dir = 0; dir < 2; dir++) {
+            for (int k = 0; k < count; k++) {
+                pair_job_t *j = &todo[k];
+                int err = 0;
+                if (dir == 0) err = pingpong_start(&pp[k], j->a, j->b, j->res_ab);
+                else if (j->res_ba) err = pingpong_start(&pp[k], j->b, j->a, j->res_ba);
+                else pp[k].data = NULL;
+                if (err) failed[k] = 1;
+            }
+            for (int k = 0; k < count; k++) {
+                pingpong_finish(&pp[k]);
+            }
+        }
+        for (int k = 0; k < count; k++) {
+            if (failed[k]) ret = -1;
+        }
+        if (!noise_check) break;
+
+        noise_snap_t *after = noise_snapshot();
+        int left = 0;
+        for (int k = 0; k < count; k++) {
+            pair_job_t *j = &todo[k];
+            if (failed[k]) continue;
+            uint64_t irqs = noise_cpu_events(before, after, j->a) +
+                            noise_cpu_events(before, after, j->b);
+            uint64_t csw_a = j->res_ab->noise_csw[0], csw_b = j->res_ab->noise_csw[1];
+            if (j->res_ba) {
+                csw_b += j->res_ba->noise_csw[0];
+                csw_a += j->res_ba->noise_csw[1];
+            }
+            int noisy = irqs > (uint64_t)noise_max || csw_a + csw_b > 0;
+            noise_account(before, after, j->a, csw_a, noisy);
+            noise_account(before, after, j->b, csw_b, noisy);
+
+            pair_result_t *r[2] = {j->res_ab, j->res_ba};
+            for (int d = 0; d < 2 && r[d]; d++) {
+                r[d]->noise_irqs = irqs;
+                r[d]->noisy = noisy;
+                r[d]->reruns = attempt;
+            }
+            if (noisy && attempt < noise_reruns) todo[left++] = *j;
+        }
+        noise_free(before);
+        noise_free(after);
+        count = left;
+        memset(failed, 0, count * sizeof(int));
+    }
+    free(failed);
+    free(todo);
+    free(pp);
+    return ret;
+}
+
+// Measures round trips between cpu1 (leader) and cpu2 (ITERATIONS, or
+// adaptive batches with -A) and stores the round-trip cycle distribution
+// in res. One-way latency is half of each sample (see ONE_WAY). Returns -1
+// and leaves res empty if either CPU has no pinned worker.
+int run_benchmark(int cpu1, int cpu2, pair_result_t *res) {
+    pair_job_t job = {cpu1, cpu2, res, NULL};
+    return measure_pingpong(&job, 1);
+}
+
+// Parallel matrix sweep.
+// Pairs are scheduled round-robin tournament style (circle method): every
+// round pairs each core with exactly one other, so N/2 disjoint pairs can be
+// measured at once and N-1 rounds cover every unordered pair. Each pair is
+// measured in both directions (or one, for a half matrix), all pairs of a
+// batch at the same time, by batch_fn (ping-pong plus optional bandwidth by default, see run_batch).
+static void run_batch(pair_job_t *jobs, int count, void *arg) {
+    (void)arg;
+    bw_t *bw = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(bw_t));
+    if (!bw) { perror("malloc"); exit(1); }
+    measure_pingpong(jobs, count);
+    for (int dir = 0; bw_size && dir < 2; dir++) {
+        for (int k = 0; k < count; k++) {
+            if (dir == 0) bw_start(&bw[k], jobs[k].a, jobs[k].b, jobs[k].res_ab);
+            else if (jobs[k].res_ba) bw_start(&bw[k], jobs[k].b, jobs[k].a, jobs[k].res_ba);
+            else bw[k].buf = NULL;
+        }
+        for (int k = 0; k < count; k++) {
+            bw_finish(&bw[k]);
+        }
+    }
+    free(bw);
+}
+
+static int domain_used(const int *used, int nused, int dom) {
+    for (int k = 0; k < nused; k++) {
+        if (used[k] == dom) return 1;
+    }
+    return 0;
+}
+
+// b -> a from a measured a -> b: a round trip is the same path either way,
+// only the threads' roles swap
+static void mirror_result(pair_result_t *dst, const pair_result_t *src) {
+    *dst = *src;
+    dst->perf[0] = src->perf[1];
+    dst->perf[1] = src->perf[0];
+    dst->noise_csw[0] = src->noise_csw[1];
+    dst->noise_csw[1] = src->noise_csw[0];
+    dst->mirrored = 1;
+}
+
+// Fills res[i * n + j] with the cpus[i] -> cpus[j] result for all i != j.
+// With half set only one direction of every pair is measured and mirrored
+// into the other.
+void run_matrix_parallel(const int *cpus, int n, isolate_t isolate, int half,
+                         pair_result_t *res, batch_fn_t batch_fn, void *arg) {
+    int m = n + (n & 1);          // odd core count gets a bye slot (-1)
+    int *ring = malloc(m * sizeof(int));
+    pair_job_t *round = malloc((m / 2) * sizeof(pair_job_t));
+    pair_job_t *batch = malloc((m / 2) * sizeof(pair_job_t));
+    int *used = malloc(m * sizeof(int));
+    if (!ring || !round || !batch || !used) { perror("malloc"); exit(1); }
+
+    for (int k = 0; k < m; k++) ring[k] = (k < n) ? k : -1;
+
+    for (int r = 0; r < m - 1; r++) {
+        int npairs = 0;
+        for (int k = 0; k < m / 2; k++) {
+            int a = ring[k], b = ring[m - 1 - k];
+            if (a < 0 || b < 0) continue;
+            round[npairs].a = cpus[a];
+            round[npairs].b = cpus[b];
+            round[npairs].res_ab = &res[a * n + b];
+            round[npairs].res_ba = half ? NULL : &res[b * n + a];
+            npairs++;
+        }
+
+        // Split the round into batches in which no two pairs touch the
+        // same isolation domain. Without isolation this is a single batch.
+        int remaining = npairs;
+        while (remaining > 0) {
+            int nbatch = 0, nused = 0, left = 0;
+            for (int k = 0; k < remaining; k++) {
+                int da = topo_domain(round[k].a, isolate);
+                int db = topo_domain(round[k].b, isolate);
+                if (isolate != ISOLATE_NONE &&
+                    (domain_used(used, nused, da) || domain_used(used, nused, db))) {
+                    round[left++] = round[k];
+                    continue;
+                }
+                used[nused++] = da;
+                if (db != da) used[nused++] = db;
+                batch[nbatch++] = round[k];
+            }
+            remaining = left;
+
+            batch_fn(batch, nbatch, arg);
+            for (int k = 0; half && k < nbatch; k++) {
+                int ab = batch[k].res_ab - res;
+                mirror_result(&res[(ab % n) * n + ab / n], batch[k].res_ab);
+            }
+        }
+
+        fprintf(stderr, "\rRound %d/%d", r + 1, m - 1);
+        fflush(stderr);
+
+        // Rotate every slot except the first
+        int last = ring[m - 1];
+        memmove(&ring[2], &ring[1], (m - 2) * sizeof(int));
+        ring[1] = last;
+    }
+    fprintf(stderr, "\n");
+
+    free(ring);
+    free(round);
+    free(batch);
+    free(used);
+}
+
+static void print_matrix_header(const int *cpus, int n) {
+    printf("      ");
+    for (int j = 0; j < n; j++) {
+        printf(" %5d", cpus[j]);
+    }
+    printf("\n");
+}
+
+// One matrix cell; pairs that could not be measured show as n/a
+static void print_cell(const lat_hist_t *hist, double scale, stat_t stat) {
+    if (hist->n == 0) {
+        printf("   n/a");
+        return;
+    }
+    lat_stats_t st;
+    hist_stats(hist, scale, &st);
+    printf(" %5.0f", stat_value(&st, stat));
+}
+
+static void print_matrix(const int *cpus, int n, const pair_result_t *res,
+                         double scale, stat_t stat) {
+    print_matrix_header(cpus, n);
+    for (int i = 0; i < n; i++) {
+        printf("%5d ", cpus[i]);
+        for (int j = 0; j < n; j++) {
+            if (i == j) printf("     -");
+            else print_cell(&res[i * n + j].hist, scale, stat);
+        }
+        printf("\n");
+    }
+}
+
+// Measures every ordered pair of cpus into res with batch_fn: tournament
+// scheduled with -p, otherwise one direction at a time, printing each cell
+// as soon as it is done. With half set, j -> i mirrors i -> j.
+static void run_matrix(const int *cpus, int n, int parallel, isolate_t isolate, int half,
+                       pair_result_t *res, batch_fn_t batch_fn, void *arg,
+                       double scale, stat_t stat) {
+    if (parallel) {
+        run_matrix_parallel(cpus, n, isolate, half, res, batch_fn, arg);
+        print_matrix(cpus, n, res, scale, stat);
+        return;
+    }
+    print_matrix_header(cpus, n);
+    for (int i = 0; i < n; i++) {
+        printf("%5d ", cpus[i]);
+        for (int j = 0; j < n; j++) {
+            if (i == j) {
+                printf("     -");
+                continue;
+            }
+            if (half && j < i) {
+                mirror_result(&res[i * n + j], &res[j * n + i]);
+            } else {
+                pair_job_t job = {cpus[i], cpus[j], &res[i * n + j], NULL};
+                batch_fn(&job, 1, arg);
+            }
+            print_cell(&res[i * n + j].hist, scale, stat);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+}
+
+// Broadcast matrix: one row per writer, every other CPU reading at once
+static void run_broadcast_matrix(const int *cpus, int n, pair_result_t *res,
+                                 double scale, stat_t stat) {
+    print_matrix_header(cpus, n);
+    for (int i = 0; i < n; i++) {
+        printf("%5d ", cpus[i]);
+        fflush(stdout);
+        run_broadcast_row(cpus, n, i, home_node, &res[i * n]);
+        for (int j = 0; j < n; j++) {
+            if (i == j) printf("     -");
+            else print_cell(&res[i * n + j].hist, scale, stat);
+        }
+        printf("\n");
+    }
+}
+
+// Bandwidth matrix in GB/s, row = producer, column = consumer
+static void print_bw_matrix(const int *cpus, int n, const pair_result_t *res) {
+    printf("\nBandwidth (GB/s, %zu bytes per transfer%s), row = producer:\n",
+           bw_size, bw_nontemporal ? ", non-temporal stores" : "");
+    print_matrix_header(cpus, n);
+    for (int i = 0; i < n; i++) {
+        printf("%5d ", cpus[i]);
+        for (int j = 0; j < n; j++) {
+            if (i == j) printf("     -");
+            else if (res[i * n + j].bw_cycles == 0) printf("   n/a");
+            else printf(" %5.1f", bw_gbps(&res[i * n + j]));
+        }
+        printf("\n");
+    }
+}
+
+// Counters per round trip for one pair (--perf)
+static void print_perf_pair(const pair_result_t *res) {
+    printf("Counters per round trip   leader  follower\n");
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (!perf_event_available(e)) continue;
+        if (e == PERF_RAW) printf("  raw 0x%-16llx", (unsigned long long)perf_raw_config);
+        else printf("  %-22s", perf_event_name(e));
+        for (int r = 0; r < 2; r++) {
+            double v = perf_per_op(&res->perf[r], e);
+            if (v < 0) printf("       n/a");
+            else printf(" %9.3f", v);
+        }
+        printf("\n");
+    }
+    if (perf_event_available(PERF_CYCLES) && perf_event_available(PERF_REF_CYCLES)) {
+        printf("  %-22s", "clock ratio");
+        for (int r = 0; r < 2; r++) {
+            double ref = perf_per_op(&res->perf[r], PERF_REF_CYCLES);
+            if (ref > 0) printf(" %9.3f", perf_per_op(&res->perf[r], PERF_CYCLES) / ref);
+            else printf("       n/a");
+        }
+        printf("\n");
+    }
+    for (int r = 0; r < 2; r++) {
+        if (perf_scaled(&res->perf[r])) {
+            printf("  %s counters multiplexed (on the PMU %.0f%% of the time), scaled up\n",
+                   r ? "follower" : "leader", res->perf[r].running * 100);
+        }
+    }
+}
+
+// Note cells whose counts were scaled because the group was multiplexed
+static void print_perf_scaled(int n, const pair_result_t *res) {
+    int scaled = 0;
+    for (int i = 0; i < n * n; i++) {
+        scaled += perf_scaled(&res[i].perf[0]) || perf_scaled(&res[i].perf[1]);
+    }
+    if (scaled) printf("(%d cells multiplexed on the PMU, counts scaled up)\n", scaled);
+}
+
+// One matrix per counted event: leader + follower count per round trip
+static void print_perf_matrix(const int *cpus, int n, const pair_result_t *res) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (!perf_event_available(e) || e == PERF_CYCLES || e == PERF_INSTRUCTIONS ||
+            e == PERF_REF_CYCLES) {
+            continue;
+        }
+        if (e == PERF_RAW) {
+            printf("\nRaw event 0x%llx per round trip (leader + follower):\n",
+                   (unsigned long long)perf_raw_config);
+        } else {
+            printf("\n%s per round trip (leader + follower):\n", perf_event_name(e));
+        }
+        print_matrix_header(cpus, n);
+        for (int i = 0; i < n; i++) {
+            printf("%5d ", cpus[i]);
+            for (int j = 0; j < n; j++) {
+                const perf_counts_t *c = res[i * n + j].perf;
+                double a = perf_per_op(&c[0], e), b = perf_per_op(&c[1], e);
+                if (i == j) printf("     -");
+                else if (a < 0 || b < 0) printf("   n/a");
+                else printf(" %5.2f", a + b);
+            }
+            printf("\n");
+        }
+        print_perf_scaled(n, res);
+    }
+    // cycles / ref-cycles of the leader: below 1 means it ran below base clock
+    if (perf_event_available(PERF_CYCLES) && perf_event_available(PERF_REF_CYCLES)) {
+        printf("\nLeader clock ratio (cycles / ref-cycles):\n");
+        print_matrix_header(cpus, n);
+        for (int i = 0; i < n; i++) {
+            printf("%5d ", cpus[i]);
+            for (int j = 0; j < n; j++) {
+                const perf_counts_t *c = &res[i * n + j].perf[0];
+                double ref = perf_per_op(c, PERF_REF_CYCLES);
+                if (i == j) printf("     -");
+                else if (ref <= 0) printf("   n/a");
+                else printf(" %5.2f", perf_per_op(c, PERF_CYCLES) / ref);
+            }
+            printf("\n");
+        }
+        print_perf_scaled(n, res);
+    }
+}
+
+// One-way stamps: (i -> j minus j -> i) / 2. A TSC offset between the two
+// cores adds to one direction and subtracts from the other, so it cancels
+// in the mean of the two but shows up here together with any real
+// asymmetry; the two cannot be told apart from stamps alone.
+static void print_asymmetry_matrix(const int *cpus, int n, const pair_result_t *res,
+                                   double scale, stat_t stat) {
+    printf("\nHalf-difference (%s i -> j minus j -> i) / 2: path asymmetry plus TSC offset\n",
+           stat_name(stat));
+    print_matrix_header(cpus, n);
+    for (int i = 0; i < n; i++) {
+        printf("%5d ", cpus[i]);
+        for (int j = 0; j < n; j++) {
+            const lat_hist_t *ij = &res[i * n + j].hist, *ji = &res[j * n + i].hist;
+            if (i == j || ij->n == 0 || ji->n == 0) {
+                printf(i == j ? "     -" : "   n/a");
+                continue;
+            }
+            lat_stats_t a, b;
+            hist_stats(ij, scale, &a);
+            hist_stats(ji, scale, &b);
+            printf(" %+5.0f", (stat_value(&a, stat) - stat_value(&b, stat)) / 2);
+        }
+        printf("\n");
+    }
+}
+
+// Pairs still noisy after their reruns; their cells should not be trusted
+static void print_noisy_pairs(const int *cpus, int n, const pair_result_t *res) {
+    int noisy = 0, rerun = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            const pair_result_t *r = &res[i * n + j];
+            if (r->reruns) rerun++;
+            if (!r->noisy) continue;
+            if (noisy++ == 0) printf("\nNoisy pairs (interrupts + softirqs, involuntary switches):\n");
+            const pair_result_t *back = &res[j * n + i];
+            unsigned csw = r->noise_csw[0] + r->noise_csw[1];
+            if (!back->mirrored) csw += back->noise_csw[0] + back->noise_csw[1];
+            printf("  %3d <-> %-3d %6llu %4u\n", cpus[i], cpus[j],
+                   (unsigned long long)r->noise_irqs, csw);
+        }
+    }
+    printf("%sNoise: %d of %d pairs noisy, %d rerun\n", noisy ? "" : "\n", noisy,
+           n * (n - 1) / 2, rerun);
+}
+
+// Number of adaptive batches each cell needed
+static void print_batch_matrix(const int *cpus, int n, const pair_result_t *res) {
+    printf("\nBatches of %d round trips per cell:\n", adapt_batch_len);
+    print_matrix_header(cpus, n);
+    for (int i = 0; i < n; i++) {
+        printf("%5d ", cpus[i]);
+        for (int j = 0; j < n; j++) {
+            if (i == j) printf("     -");
+            else printf(" %5d", res[i * n + j].batches);
+        }
+        printf("\n");
+    }
+}
+
+// Mean and p99 per topology tier over every measured ordered pair
+static void print_tier_summary(const int *cpus, int n, const pair_result_t *res,
+                               double scale, const char *unit) {
+    lat_hist_t *tiers = malloc(NUM_TIERS * sizeof(lat_hist_t));
+    int pairs[NUM_TIERS] = {0};
+    if (!tiers) { perror("malloc"); return; }
+    for (int t = 0; t < NUM_TIERS; t++) hist_init(&tiers[t]);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (i == j || res[i * n + j].hist.n == 0) continue;
+            tier_t t = topo_tier(cpus[i], cpus[j]);
+            hist_merge(&tiers[t], &res[i * n + j].hist);
+            pairs[t]++;
+        }
+    }
+
+    printf("\nTopology tier (one-way, %s)  pairs      mean       p99\n", unit);
+    for (int t = 0; t < NUM_TIERS; t++) {
+        if (pairs[t] == 0) continue;
+        lat_stats_t st;
+        hist_stats(&tiers[t], scale, &st);
+        printf("  %-26s %6d %9.1f %9.1f\n", tier_name(t), pairs[t], st.mean, st.p99);
+    }
+    free(tiers);
+}
+
+static double elapsed_sec(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void print_distribution(const lat_stats_t *st) {
+    double ns = 1e9 / tsc_hz;
+    printf("Latency (one-way):  cycles        ns\n");
+    printf("  Min:            %8.1f  %8.1f\n", st->min, st->min * ns);
+    printf("  Mean:           %8.1f  %8.1f\n", st->mean, st->mean * ns);
+    printf("  p50:            %8.1f  %8.1f\n", st->p50, st->p50 * ns);
+    printf("  p90:            %8.1f  %8.1f\n", st->p90, st->p90 * ns);
+    printf("  p99:            %8.1f  %8.1f\n", st->p99, st->p99 * ns);
+    printf("  p99.9:          %8.1f  %8.1f\n", st->p999, st->p999 * ns);
+    printf("  Max:            %8.1f  %8.1f\n", st->max, st->max * ns);
+}
+
+// Lock handoff mode (--locks): one pair, or one matrix per lock type
+static void run_locks(const int *cpus, int n, unsigned lock_mask, int cpu1, int cpu2,
+                      int parallel, isolate_t isolate, double scale, stat_t stat,
+                      const char *unit) {
+    for (int l = 0; l < NUM_LOCK_TYPES; l++) {
+        if (!(lock_mask & (1u << l))) continue;
+        lock_type_t type = (lock_type_t)l;
+
+        if (cpu1 >= 0) {
+            printf("\n%s, handoff between core %d and %d...\n", lock_type_name(type), cpu1, cpu2);
+            pair_result_t res;
+            if (run_lock_handoff(type, cpu1, cpu2, &res) != 0) {
+                fprintf(stderr, "Could not pin to CPU %d and %d\n", cpu1, cpu2);
+                return;
+            }
+            lat_stats_t st;
+            hist_stats(&res.hist, ONE_WAY, &st);
+            print_distribution(&st);
+            printf("Throughput: %.2f M handoffs/s\n", lock_handoffs_per_sec(&res) / 1e6);
+            continue;
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pair_result_t *res = calloc((size_t)n * n, sizeof(pair_result_t));
+        if (!res) { perror("calloc"); return; }
+
+        printf("\n%s handoff latency for %d cores%s...\n", lock_type_name(type), n,
+               parallel ? " (parallel sweep)" : "");
+        run_matrix(cpus, n, parallel, isolate, 0, res, lock_batch, &type, scale, stat);
+        printf("Matrix cells: %s handoff %s latency in %s, row = timing core\n",
+               lock_type_name(type), stat_name(stat), unit);
+        print_tier_summary(cpus, n, res, scale, unit);
+        printf("Matrix completed in %.1f s\n", elapsed_sec(&start));
+        free(res);
+    }
+}
+
+// Wakeup mode (--wakeup): one pair, or one matrix per mechanism and spin
+// threshold. Cells use the same one-way scale as the ping-pong matrix.
+static void run_wakeup_mode(const int *cpus, int n, unsigned wake_mask,
+                            const int *spin_ns, int nspins, int cpu1, int cpu2,
+                            int parallel, isolate_t isolate, double scale, stat_t stat,
+                            const char *unit) {
+    for (int w = 0; w < NUM_WAKE_TYPES; w++) {
+        if (!(wake_mask & (1u << w))) continue;
+        for (int s = 0; s < nspins; s++) {
+            wake_cfg_t cfg = {(wake_type_t)w, (uint64_t)(spin_ns[s] * tsc_hz / 1e9)};
+            char label[64];
+            if (spin_ns[s]) {
+                snprintf(label, sizeof(label), "%s, spin %d ns", wake_type_name(cfg.type), spin_ns[s]);
+            } else {
+                snprintf(label, sizeof(label), "%s", wake_type_name(cfg.type));
+            }
+
+            if (cpu1 >= 0) {
+                printf("\n%s, wakeup between core %d and %d...\n", label, cpu1, cpu2);
+                pair_result_t res;
+                if (run_wakeup(&cfg, cpu1, cpu2, &res) != 0) {
+                    fprintf(stderr, "Could not pin to CPU %d and %d\n", cpu1, cpu2);
+                    return;
+                }
+                lat_stats_t st;
+                hist_stats(&res.hist, ONE_WAY, &st);
+                print_distribution(&st);
+                continue;
+            }
+
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            pair_result_t *res = calloc((size_t)n * n, sizeof(pair_result_t));
+            if (!res) { perror("calloc"); return; }
+
+            printf("\n%s wakeup latency for %d cores%s...\n", label, n,
+                   parallel ? " (parallel sweep)" : "");
+            run_matrix(cpus, n, parallel, isolate, 0, res, wake_batch, &cfg, scale, stat);
+            printf("Matrix cells: %s wakeup %s latency in %s, row = timing core\n",
+                   label, stat_name(stat), unit);
+            print_tier_summary(cpus, n, res, scale, unit);
+            printf("Matrix completed in %.1f s\n", elapsed_sec(&start));
+            free(res);
+        }
+    }
+}
+
+// SPSC ring mode (--ring): one pair, or latency and throughput matrices.
+// Ring samples are already one-way, so the ONE_WAY halving is undone.
+static void run_ring_mode(const int *cpus, int n, int cpu1, int cpu2, int parallel,
+                          isolate_t isolate, double scale, stat_t stat, const char *unit) {
+    printf("SPSC ring: %zu-byte messages, depth %d, publish every %d, %s indices\n",
+           ring_msg_size, ring_depth, ring_batch, ring_naive ? "naive" : "cached");
+
+    if (cpu1 >= 0) {
+        pair_result_t res;
+        if (run_ring(cpu1, cpu2, &res) != 0) {
+            fprintf(stderr, "Could not pin to CPU %d and %d\n", cpu1, cpu2);
+            return;
+        }
+        double rate = ring_msgs_per_sec(&res);
+        printf("Ring %d -> %d: %.2f M msgs/s (%.2f GB/s)\n", cpu1, cpu2,
+               rate / 1e6, rate * ring_msg_size / 1e9);
+        lat_stats_t st;
+        hist_stats(&res.hist, 1.0, &st);
+        print_distribution(&st);
+        return;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pair_result_t *res = calloc((size_t)n * n, sizeof(pair_result_t));
+    if (!res) { perror("calloc"); return; }
+
+    scale /= ONE_WAY;
+    printf("Measuring SPSC ring for %d cores%s...\n", n, parallel ? " (parallel sweep)" : "");
+    run_matrix(cpus, n, parallel, isolate, 0, res, ring_pair_batch, NULL, scale, stat);
+    printf("Matrix cells: per-message %s latency in %s, row = producer\n", stat_name(stat), unit);
+
+    printf("\nThroughput (M msgs/s), row = producer:\n");
+    print_matrix_header(cpus, n);
+    for (int i = 0; i < n; i++) {
+        printf("%5d ", cpus[i]);
+        for (int j = 0; j < n; j++) {
+            if (i == j) printf("     -");
+            else if (res[i * n + j].ring_cycles == 0) printf("   n/a");
+            else printf(" %5.1f", ring_msgs_per_sec(&res[i * n + j]) / 1e6);
+        }
+        printf("\n");
+    }
+    print_tier_summary(cpus, n, res, scale, unit);
+    printf("Matrix completed in %.1f s\n", elapsed_sec(&start));
+    free(res);
 }
 
 void print_help(char *prog) {
-    printf("Usage: %s [-c cpu1,cpu2] [-m] [-h]\n", prog);
+    printf("Usage: %s [-c cpu1,cpu2] [-m [-p] [-I socket|l3]] [-C cpulist] [-s stat] [-u unit] [-B n] [-A err] [-b size [--nt]]\n"
+           "       [--contention op [--step n]]\n"
+           "       [--false-sharing [--threads n] [--strides list]] [--locks list]\n"
+           "       [--ring [--msg-size n] [--depth n] [--ring-batch n] [--naive]]\n"
+           "       [--wakeup list [--spin-ns list]]\n"
+           "       [--numa [--chase-size size] [--hugepages]]\n"
+           "       [--stream [--kernel k] [--nt] [--threads n] [--stream-size size] [--mem-nodes list]]\n"
+           "       [--cache-sweep [--chase-size max] [--hugepages]]\n"
+           "       [--token-ring [--ring-order list] [--optimize]]\n"
+           "       [--place graph [--matrix-file file.json] [--no-smt] [--nodes list]]\n"
+           "       [--pattern store|load|rfo|cas|xchg|broadcast|oneway] [--oneway] [--full]\n"
+           "       [--home node|all]\n"
+           "       [--perf [--perf-raw config]] [--noise [--noise-max n] [--noise-reruns n]]\n"
+           "       [--json file] [--csv file] [--heatmap file.svg|file.html]\n"
+           "       [--baseline file.json [--regress-pct pct]] [-T] [-h]\n", prog);
     printf("  -c: Measure latency between two specific cores.\n");
     printf("  -m: Output a matrix of latencies for all core pairs.\n");
+    printf("  -C, --cpu-list list: Restrict the matrix to these CPUs (e.g. 0-15,64-79).\n");
+    printf("      Only online CPUs in the process affinity mask are ever used.\n");
+    printf("  -p, --parallel: Measure disjoint core pairs concurrently (matrix mode).\n");
+    printf("  -I, --isolate socket|l3: With -p, never run two pairs at once that\n");
+    printf("      share a socket / L3 domain.\n");
+    printf("  -s, --stat mean|min|p50|p90|p99|p999|max: Value shown in matrix cells\n");
+    printf("      (default mean).\n");
+    printf("  -u, --unit cycles|ns: Unit of matrix cells (default cycles).\n");
+    printf("  -B, --batch n: Round trips per histogram sample (default 1).\n");
+    printf("  -A, --adaptive err: Run batches until the 95%% CI of the median is\n");
+    printf("      within +/- err (relative, e.g. 0.01) instead of a fixed count.\n");
+    printf("      --batch-len n: Round trips per batch (default %d).\n", ITERATIONS / 10);
+    printf("      --min-batches n, --max-batches n: Batch caps (default 5, 100).\n");
+    printf("  -b, --bandwidth size: Also measure producer->consumer bandwidth moving\n");
+    printf("      size bytes (64 to 64M, K/M suffixes) per transfer.\n");
+    printf("      --nt: Producer writes with non-temporal stores.\n");
+    printf("  --contention store|xadd|cas|read: Hammer one cache line from N threads,\n");
+    printf("      N = 1..all selected CPUs in topology order (--step n between runs).\n");
+    printf("  --false-sharing: Per-thread counters at a byte stride (--strides, default\n");
+    printf("      8,64,128,256); one pair per topology tier, or the first --threads n CPUs.\n");
+    printf("  --locks tas,ticket,mcs,futex|all: With -c or -m, measure lock handoff\n");
+    printf("      latency between the cores instead of the plain cache line ping-pong.\n");
+    printf("  --ring: With -c or -m, stream messages through an SPSC ring from the first\n");
+    printf("      core (producer) to the second; reports msgs/s and per-message latency.\n");
+    printf("      --msg-size n: Bytes per message, multiple of 8 (default 64).\n");
+    printf("      --depth n: Ring slots, power of two (default 256).\n");
+    printf("      --ring-batch n: Publish head/tail every n messages (default 1).\n");
+    printf("      --naive: Reread the peer's index for every message instead of\n");
+    printf("      caching it.\n");
+    printf("  --wakeup futex,eventfd,pipe,condvar|all: With -c or -m, measure the\n");
+    printf("      latency of waking a blocked thread on the other core.\n");
+    printf("      --spin-ns list: Spin this long before blocking, one run per value\n");
+    printf("      (default 0 = block at once).\n");
+    printf("  --numa: Dependent-load latency from every selected core to every memory\n");
+    printf("      node (ns per load, pointer chase through a random chain).\n");
+    printf("      --chase-size size: Buffer per node (default 256M, K/M/G suffixes).\n");
+    printf("      --hugepages: Back the buffers with huge pages to avoid TLB misses.\n");
+    printf("  --stream: STREAM copy/scale/add/triad GB/s per (CPU node, memory node).\n");
+    printf("      --kernel scalar|avx2|avx512|auto: Kernel flavour (default auto).\n");
+    printf("      --nt: Non-temporal stores. --threads n: Threads per CPU node\n");
+    printf("      (default all selected CPUs of the node, one per core first).\n");
+    printf("      --stream-size size: Bytes per array (default 128M).\n");
+    printf("      --mem-nodes list: Memory nodes to bind to (default all).\n");
+    printf("  --token-ring: Pass a token around a ring of the selected CPUs (in\n");
+    printf("      topology order) and time full rotations.\n");
+    printf("      --ring-order list: Use these CPUs in this order, e.g. 0,8,1,9.\n");
+    printf("      --optimize: Measure the pairwise matrix first, then also measure\n");
+    printf("      orders found by nearest neighbour and 2-opt and report the best.\n");
+    printf("  --place graph: Assign the stages of a communication graph (lines of\n");
+    printf("      'sender receiver [weight]') to the selected CPUs, minimizing the\n");
+    printf("      weighted one-way latency; prints a taskset line per stage.\n");
+    printf("      --matrix-file file: Use the latencies of an earlier --json result instead\n");
+    printf("      of measuring the matrix first.\n");
+    printf("      --no-smt: Never put two stages on SMT siblings of one core.\n");
+    printf("      --nodes list: Only use CPUs of these NUMA nodes.\n");
+    printf("  --cache-sweep: Latency and read bandwidth vs working-set size on the first\n");
+    printf("      selected CPU (pick it with -C), with cache level detection. The sweep\n");
+    printf("      runs up to --chase-size (default 4x the last level cache).\n");
+    printf("  --pattern p: Ping-pong access pattern: store (default, one line), load\n");
+    printf("      (load after remote store, two lines), rfo (timed store to a line the\n");
+    printf("      other core holds shared), cas, xchg (locked handoffs), broadcast (one\n");
+    printf("      writer, all other CPUs read; matrix only, one row per writer),\n");
+    printf("      oneway (see --oneway).\n");
+    printf("  --oneway: One-way latency from TSC stamps: the leader stamps each ping,\n");
+    printf("      the follower subtracts the stamp from its TSC at arrival. Includes the\n");
+    printf("      TSC offset between the cores; the matrix adds a half-difference\n");
+    printf("      (asymmetry) matrix. Pair mode measures both directions.\n");
+    printf("  --full: Measure both directions of every pair. By default round-trip\n");
+    printf("      patterns measure one and mirror it (rfo, oneway, -b always run both).\n");
+    printf("  --home node|all: Bind the ping-pong's shared lines to this NUMA node's\n");
+    printf("      memory, or repeat the run once per node (default: first touch).\n");
+    printf("  --perf: Count cycles, instructions, ref-cycles, LLC misses and context\n");
+    printf("      switches on leader and follower during the timed ping-pong.\n");
+    printf("      --perf-raw config: Also count this raw PMU event (e.g. a HITM event).\n");
+    printf("  --noise: Snapshot interrupts, softirqs and involuntary context switches\n");
+    printf("      around every ping-pong pair, flag disturbed pairs and print a per-core\n");
+    printf("      noise report.\n");
+    printf("      --noise-max n: Interrupts + softirqs a pair may take, timer ticks\n");
+    printf("      not counted (default 0).\n");
+    printf("      --noise-reruns n: Measure noisy pairs again up to n times (default 0).\n");
+    printf("  --json file: With -m, also write the matrix as JSON: host fingerprint\n");
+    printf("      (kernel, CPU model, microcode, governor, TSC), topology and per-pair\n");
+    printf("      statistics with histograms, counters and noise if measured.\n");
+    printf("  --csv file: With -m, write one CSV row per ordered pair.\n");
+    printf("  --heatmap file: With -m, write an SVG heatmap of the -s statistic in the\n");
+    printf("      -u unit, or an HTML page with host details if file ends in .html.\n");
+    printf("  --baseline file: With -m, compare against an earlier --json result: KS\n");
+    printf("      test per cell plus a median shift threshold, summary per tier. Exits\n");
+    printf("      with status 2 if a cell or tier regressed.\n");
+    printf("      --regress-pct pct: Median shift that counts as a change (default 5).\n");
+    printf("  -T, --topology: Print the CPU topology in matrix order and exit.\n");
     printf("  -h: Show this help.\n");
 }
 
 int main(int argc, char *argv[]) {
     int opt;
-    int mode_matrix = 0;
+    enum { MODE_NONE, MODE_PAIR, MODE_MATRIX, MODE_TOPOLOGY, MODE_CONTENTION,
+           MODE_FALSE_SHARING, MODE_NUMA, MODE_STREAM,
+           MODE_CACHE_SWEEP, MODE_TOKEN_RING, MODE_PLACE } mode = MODE_NONE;
+    contention_op_t contention_op = OP_XADD;
+    int sweep_step = 1;
+    int nthreads = 0;       // 0 = mode default
+    int strides[16] = {8, 64, 128, 256};
+    int nstrides = 4;
+    int parallel = 0;
+    isolate_t isolate = ISOLATE_NONE;
+    stat_t stat = STAT_MEAN;
+    int unit_ns = 0;
     int cpu1 = -1, cpu2 = -1;
-    
-    while ((opt = getopt(argc, argv, "mc:h")) != -1) {
+    const char *cpulist = NULL;
+    unsigned lock_mask = 0;
+    int ring = 0;
+    unsigned wake_mask = 0;
+    int spin_ns[16] = {0};
+    int nspins = 1;
+    size_t chase_size = 0;  // 0 = mode default
+    int hugepages = 0;
+    int stream_kernel = -1;
+    size_t stream_size = 128 << 20;
+    const char *mem_node_list = NULL;
+    const char *home_arg = NULL;
+    int use_perf = 0;
+    const char *json_path = NULL, *csv_path = NULL, *heatmap_path = NULL;
+    const char *baseline_path = NULL;
+    int full_matrix = 0;
+    const char *ring_order = NULL;
+    int optimize = 0;
+    const char *place_graph = NULL, *matrix_path = NULL, *place_nodes = NULL;
+    int no_smt = 0;
+    double regress_pct = 5.0;
+
+    enum { OPT_BATCH_LEN = 256, OPT_MIN_BATCHES, OPT_MAX_BATCHES, OPT_NT,
+           OPT_CONTENTION, OPT_STEP, OPT_FALSE_SHARING, OPT_THREADS, OPT_STRIDES,
+           OPT_LOCKS, OPT_RING, OPT_MSG_SIZE, OPT_DEPTH, OPT_RING_BATCH, OPT_NAIVE,
+           OPT_WAKEUP, OPT_SPIN_NS, OPT_NUMA, OPT_CHASE_SIZE, OPT_HUGEPAGES,
+           OPT_STREAM, OPT_KERNEL, OPT_STREAM_SIZE, OPT_MEM_NODES,
+           OPT_CACHE_SWEEP, OPT_PATTERN, OPT_ONEWAY, OPT_FULL, OPT_TOKEN_RING, OPT_RING_ORDER,
+           OPT_OPTIMIZE, OPT_PLACE, OPT_MATRIX, OPT_NO_SMT, OPT_NODES, OPT_HOME,
+           OPT_PERF, OPT_PERF_RAW, OPT_NOISE, OPT_NOISE_MAX, OPT_NOISE_RERUNS,
+           OPT_JSON, OPT_CSV, OPT_HEATMAP, OPT_BASELINE, OPT_REGRESS_PCT };
+    static const struct option long_opts[] = {
+        {"matrix",   no_argument,       NULL, 'm'},
+        {"cpus",     required_argument, NULL, 'c'},
+        {"cpu-list", required_argument, NULL, 'C'},
+        {"parallel", no_argument,       NULL, 'p'},
+        {"isolate",  required_argument, NULL, 'I'},
+        {"stat",     required_argument, NULL, 's'},
+        {"unit",     required_argument, NULL, 'u'},
+        {"batch",    required_argument, NULL, 'B'},
+        {"adaptive", required_argument, NULL, 'A'},
+        {"batch-len", required_argument, NULL, OPT_BATCH_LEN},
+        {"min-batches", required_argument, NULL, OPT_MIN_BATCHES},
+        {"max-batches", required_argument, NULL, OPT_MAX_BATCHES},
+        {"bandwidth", required_argument, NULL, 'b'},
+        {"nt",       no_argument,       NULL, OPT_NT},
+        {"contention", required_argument, NULL, OPT_CONTENTION},
+        {"step",     required_argument, NULL, OPT_STEP},
+        {"false-sharing", no_argument,  NULL, OPT_FALSE_SHARING},
+        {"threads",  required_argument, NULL, OPT_THREADS},
+        {"strides",  required_argument, NULL, OPT_STRIDES},
+        {"locks",    required_argument, NULL, OPT_LOCKS},
+        {"ring",     no_argument,       NULL, OPT_RING},
+        {"msg-size", required_argument, NULL, OPT_MSG_SIZE},
+        {"depth",    required_argument, NULL, OPT_DEPTH},
+        {"ring-batch", required_argument, NULL, OPT_RING_BATCH},
+        {"naive",    no_argument,       NULL, OPT_NAIVE},
+        {"wakeup",   required_argument, NULL, OPT_WAKEUP},
+        {"spin-ns",  required_argument, NULL, OPT_SPIN_NS},
+        {"numa",     no_argument,       NULL, OPT_NUMA},
+        {"chase-size", required_argument, NULL, OPT_CHASE_SIZE},
+        {"hugepages", no_argument,      NULL, OPT_HUGEPAGES},
+        {"stream",   no_argument,       NULL, OPT_STREAM},
+        {"kernel",   required_argument, NULL, OPT_KERNEL},
+        {"stream-size", required_argument, NULL, OPT_STREAM_SIZE},
+        {"mem-nodes", required_argument, NULL, OPT_MEM_NODES},
+        {"cache-sweep", no_argument,    NULL, OPT_CACHE_SWEEP},
+        {"token-ring", no_argument,     NULL, OPT_TOKEN_RING},
+        {"ring-order", required_argument, NULL, OPT_RING_ORDER},
+        {"optimize", no_argument,       NULL, OPT_OPTIMIZE},
+        {"place",    required_argument, NULL, OPT_PLACE},
+        {"matrix-file", required_argument, NULL, OPT_MATRIX},
+        {"no-smt",   no_argument,       NULL, OPT_NO_SMT},
+        {"nodes",    required_argument, NULL, OPT_NODES},
+        {"pattern",  required_argument, NULL, OPT_PATTERN},
+        {"oneway",   no_argument,       NULL, OPT_ONEWAY},
+        {"full",     no_argument,       NULL, OPT_FULL},
+        {"home",     required_argument, NULL, OPT_HOME},
+        {"perf",     no_argument,       NULL, OPT_PERF},
+        {"perf-raw", required_argument, NULL, OPT_PERF_RAW},
+        {"noise",    no_argument,       NULL, OPT_NOISE},
+        {"noise-max", required_argument, NULL, OPT_NOISE_MAX},
+        {"noise-reruns", required_argument, NULL, OPT_NOISE_RERUNS},
+        {"json",     required_argument, NULL, OPT_JSON},
+        {"csv",      required_argument, NULL, OPT_CSV},
+        {"heatmap",  required_argument, NULL, OPT_HEATMAP},
+        {"baseline", required_argument, NULL, OPT_BASELINE},
+        {"regress-pct", required_argument, NULL, OPT_REGRESS_PCT},
+        {"topology", no_argument,       NULL, 'T'},
+        {"help",     no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "mc:C:pI:s:u:B:A:b:Th", long_opts, NULL)) != -1) {
         switch (opt) {
             case 'm':
-                mode_matrix = 1;
+                mode = MODE_MATRIX;
                 break;
             case 'c':
                 sscanf(optarg, "%d,%d", &cpu1, &cpu2);
+                mode = MODE_PAIR;
+                break;
+            case 'C':
+                cpulist = optarg;
+                break;
+            case 'p':
+                parallel = 1;
+                break;
+            case 'I':
+                if (strcmp(optarg, "socket") == 0) {
+                    isolate = ISOLATE_SOCKET;
+                } else if (strcmp(optarg, "l3") == 0) {
+                    isolate = ISOLATE_L3;
+                } else {
+                    fprintf(stderr, "Unknown isolation domain '%s'\n", optarg);
+                    return 1;
+                }
+                parallel = 1;
+                break;
+            case 's': {
+                int st = stat_parse(optarg);
+                if (st < 0) {
+                    fprintf(stderr, "Unknown statistic '%s'\n", optarg);
+                    return 1;
+                }
+                stat = (stat_t)st;
+                break;
+            }
+            case 'u':
+                if (strcmp(optarg, "ns") == 0) {
+                    unit_ns = 1;
+                } else if (strcmp(optarg, "cycles") == 0) {
+                    unit_ns = 0;
+                } else {
+                    fprintf(stderr, "Unknown unit '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'B':
+                batch_size = atoi(optarg);
+                if (batch_size < 1 || batch_size > ITERATIONS) {
+                    fprintf(stderr, "Batch size must be between 1 and %d\n", ITERATIONS);
+                    return 1;
+                }
+                break;
+            case 'A':
+                adapt_rel_err = atof(optarg);
+                if (adapt_rel_err <= 0 || adapt_rel_err >= 1) {
+                    fprintf(stderr, "Relative error must be between 0 and 1\n");
+                    return 1;
+                }
+                break;
+            case OPT_BATCH_LEN:
+                adapt_batch_len = atoi(optarg);
+                break;
+            case OPT_MIN_BATCHES:
+                adapt_min_batches = atoi(optarg);
+                break;
+            case OPT_MAX_BATCHES:
+                adapt_max_batches = atoi(optarg);
+                break;
+            case 'b':
+                bw_size = parse_size(optarg);
+                if (bw_size < CACHE_LINE_SIZE || bw_size > (64 << 20)) {
+                    fprintf(stderr, "Bandwidth transfer size must be between 64 and 64M bytes\n");
+                    return 1;
+                }
+                // Whole cache lines only
+                bw_size = (bw_size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+                break;
+            case OPT_NT:
+                bw_nontemporal = 1;
+                break;
+            case OPT_CONTENTION: {
+                int op = contention_op_parse(optarg);
+                if (op < 0) {
+                    fprintf(stderr, "Unknown contention op '%s'\n", optarg);
+                    return 1;
+                }
+                contention_op = (contention_op_t)op;
+                mode = MODE_CONTENTION;
+                break;
+            }
+            case OPT_STEP:
+                sweep_step = atoi(optarg);
+                if (sweep_step < 1) {
+                    fprintf(stderr, "Step must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case OPT_FALSE_SHARING:
+                mode = MODE_FALSE_SHARING;
+                break;
+            case OPT_THREADS:
+                nthreads = atoi(optarg);
+                if (nthreads < 1) {
+                    fprintf(stderr, "Need at least 1 thread\n");
+                    return 1;
+                }
+                break;
+            case OPT_STRIDES: {
+                char *list = strdup(optarg);
+                nstrides = 0;
+                for (char *tok = strtok(list, ","); tok && nstrides < 16; tok = strtok(NULL, ",")) {
+                    int stride = atoi(tok);
+                    if (stride < 8 || stride > 4096 || stride % 8) {
+                        fprintf(stderr, "Strides must be multiples of 8 between 8 and 4096\n");
+                        return 1;
+                    }
+                    strides[nstrides++] = stride;
+                }
+                free(list);
+                break;
+            }
+            case OPT_LOCKS: {
+                char *list = strdup(optarg);
+                for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+                    int l = strcmp(tok, "all") == 0 ? NUM_LOCK_TYPES : lock_type_parse(tok);
+                    if (l < 0) {
+                        fprintf(stderr, "Unknown lock type '%s'\n", tok);
+                        return 1;
+                    }
+                    lock_mask |= l == NUM_LOCK_TYPES ? (1u << NUM_LOCK_TYPES) - 1 : 1u << l;
+                }
+                free(list);
+                break;
+            }
+            case OPT_RING:
+                ring = 1;
+                break;
+            case OPT_MSG_SIZE:
+                ring_msg_size = parse_size(optarg);
+                if (ring_msg_size < 8 || ring_msg_size > 65536 || ring_msg_size % 8) {
+                    fprintf(stderr, "Message size must be a multiple of 8 between 8 and 64K\n");
+                    return 1;
+                }
+                break;
+            case OPT_DEPTH:
+                ring_depth = atoi(optarg);
+                if (ring_depth < 2 || ring_depth > (1 << 20) || (ring_depth & (ring_depth - 1))) {
+                    fprintf(stderr, "Ring depth must be a power of two between 2 and 1M\n");
+                    return 1;
+                }
+                break;
+            case OPT_RING_BATCH:
+                ring_batch = atoi(optarg);
+                if (ring_batch < 1) {
+                    fprintf(stderr, "Ring batch must be at least 1\n");
+                    return 1;
+                }
+                break;
+            case OPT_NAIVE:
+                ring_naive = 1;
+                break;
+            case OPT_WAKEUP: {
+                char *list = strdup(optarg);
+                for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+                    int w = strcmp(tok, "all") == 0 ? NUM_WAKE_TYPES : wake_type_parse(tok);
+                    if (w < 0) {
+                        fprintf(stderr, "Unknown wakeup mechanism '%s'\n", tok);
+                        return 1;
+                    }
+                    wake_mask |= w == NUM_WAKE_TYPES ? (1u << NUM_WAKE_TYPES) - 1 : 1u << w;
+                }
+                free(list);
+                break;
+            }
+            case OPT_SPIN_NS: {
+                char *list = strdup(optarg);
+                nspins = 0;
+                for (char *tok = strtok(list, ","); tok && nspins < 16; tok = strtok(NULL, ",")) {
+                    spin_ns[nspins] = atoi(tok);
+                    if (spin_ns[nspins] < 0 || spin_ns[nspins] > 10000000) {
+                        fprintf(stderr, "Spin thresholds must be between 0 and 10000000 ns\n");
+                        return 1;
+                    }
+                    nspins++;
+                }
+                free(list);
+                if (nspins == 0) {
+                    fprintf(stderr, "Empty spin threshold list\n");
+                    return 1;
+                }
+                break;
+            }
+            case OPT_NUMA:
+                mode = MODE_NUMA;
+                break;
+            case OPT_CHASE_SIZE:
+                chase_size = parse_size(optarg);
+                if (chase_size < (64 << 10)) {
+                    fprintf(stderr, "Chase buffer must be at least 64K\n");
+                    return 1;
+                }
+                chase_size &= ~(size_t)4095;
+                break;
+            case OPT_HUGEPAGES:
+                hugepages = 1;
+                break;
+            case OPT_STREAM:
+                mode = MODE_STREAM;
+                break;
+            case OPT_KERNEL:
+                stream_kernel = stream_kernel_parse(optarg);
+                if (stream_kernel < 0) {
+                    fprintf(stderr, "Unknown kernel '%s'\n", optarg);
+                    return 1;
+                }
+                if (!stream_kernel_supported(stream_kernel)) {
+                    fprintf(stderr, "This CPU does not support the %s kernel\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_STREAM_SIZE:
+                stream_size = parse_size(optarg);
+                if (stream_size < (1 << 20)) {
+                    fprintf(stderr, "Stream arrays must be at least 1M\n");
+                    return 1;
+                }
+                break;
+            case OPT_MEM_NODES:
+                mem_node_list = optarg;
+                break;
+            case OPT_CACHE_SWEEP:
+                mode = MODE_CACHE_SWEEP;
+                break;
+            case OPT_TOKEN_RING:
+                mode = MODE_TOKEN_RING;
+                break;
+            case OPT_RING_ORDER:
+                ring_order = optarg;
+                break;
+            case OPT_OPTIMIZE:
+                optimize = 1;
+                break;
+            case OPT_PLACE:
+                mode = MODE_PLACE;
+                place_graph = optarg;
+                break;
+            case OPT_MATRIX:
+                matrix_path = optarg;
+                break;
+            case OPT_NO_SMT:
+                no_smt = 1;
+                break;
+            case OPT_NODES:
+                place_nodes = optarg;
+                break;
+            case OPT_PATTERN: {
+                int p = -1;
+                for (int k = 0; k < NUM_PATTERNS; k++) {
+                    if (strcmp(optarg, pattern_names[k]) == 0) p = k;
+                }
+                if (p < 0) {
+                    fprintf(stderr, "Unknown pattern '%s'\n", optarg);
+                    return 1;
+                }
+                pattern = (pattern_t)p;
+                break;
+            }
+            case OPT_ONEWAY:
+                pattern = PATTERN_ONEWAY;
+                break;
+            case OPT_FULL:
+                full_matrix = 1;
+                break;
+            case OPT_HOME:
+                home_arg = optarg;
+                break;
+            case OPT_PERF:
+                use_perf = 1;
+                break;
+            case OPT_PERF_RAW: {
+                char *end;
+                perf_raw_config = strtoull(optarg, &end, 0);
+                if (end == optarg || *end || perf_raw_config == 0) {
+                    fprintf(stderr, "Invalid raw event '%s'\n", optarg);
+                    return 1;
+                }
+                use_perf = 1;
+                break;
+            }
+            case OPT_NOISE:
+                noise_check = 1;
+                break;
+            case OPT_NOISE_MAX:
+                noise_max = atoi(optarg);
+                if (noise_max < 0) {
+                    fprintf(stderr, "Noise threshold must not be negative\n");
+                    return 1;
+                }
+                noise_check = 1;
+                break;
+            case OPT_NOISE_RERUNS:
+                noise_reruns = atoi(optarg);
+                if (noise_reruns < 0) {
+                    fprintf(stderr, "Noise reruns must not be negative\n");
+                    return 1;
+                }
+                noise_check = 1;
+                break;
+            case OPT_JSON:
+                json_path = optarg;
+                break;
+            case OPT_CSV:
+                csv_path = optarg;
+                break;
+            case OPT_HEATMAP:
+                heatmap_path = optarg;
+                break;
+            case OPT_BASELINE:
+                baseline_path = optarg;
+                break;
+            case OPT_REGRESS_PCT:
+                regress_pct = atof(optarg);
+                if (regress_pct < 0) {
+                    fprintf(stderr, "Regression threshold must not be negative\n");
+                    return 1;
+                }
+                break;
+            case 'T':
+                mode = MODE_TOPOLOGY;
                 break;
             case 'h':
                 print_help(argv[0]);
@@ -191,7 +1573,56 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    if (!mode_matrix && (cpu1 == -1 || cpu2 == -1)) {
+    if (adapt_batch_len < batch_size || adapt_min_batches < 1 ||
+        adapt_max_batches < adapt_min_batches) {
+        fprintf(stderr, "Need batch-len >= -B and 1 <= min-batches <= max-batches\n");
+        return 1;
+    }
+    if (pattern == PATTERN_BROADCAST && mode == MODE_PAIR) {
+        fprintf(stderr, "The broadcast pattern needs matrix mode (-m)\n");
+        return 1;
+    }
+    // Ring, lock and wakeup modes run their own protocols; a pattern would
+    // only change how their samples are scaled
+    if (pattern != PATTERN_STORE && (ring || lock_mask || wake_mask)) {
+        fprintf(stderr, "--pattern cannot be combined with --ring, --locks or --wakeup\n");
+        return 1;
+    }
+    if (ring_batch > ring_depth) {
+        fprintf(stderr, "Ring batch must not exceed the ring depth\n");
+        return 1;
+    }
+
+    // Home nodes of the shared line: first touch, one node, or all of them
+    int homes[1024] = {-1};
+    int nhomes = 1;
+    if (home_arg && strcmp(home_arg, "all") == 0) {
+        nhomes = numa_mem_nodes(homes, 1024);
+    } else if (home_arg) {
+        int nodes[1024];
+        int nnodes = numa_mem_nodes(nodes, 1024);
+        char *end;
+        homes[0] = strtol(home_arg, &end, 10);
+        int found = 0;
+        for (int k = 0; k < nnodes; k++) found |= nodes[k] == homes[0];
+        if (end == home_arg || *end || !found || homes[0] < 0) {
+            fprintf(stderr, "Invalid home node '%s' (not a node with memory)\n", home_arg);
+            return 1;
+        }
+    }
+
+    if ((json_path || csv_path || heatmap_path || baseline_path) &&
+        (mode != MODE_MATRIX || lock_mask || ring || wake_mask || nhomes > 1)) {
+        fprintf(stderr, "--json, --csv, --heatmap and --baseline need a plain -m run with one "
+                "home node\n");
+        return 1;
+    }
+    // Load the baseline up front so a bad file fails before the measurement
+    baseline_t *baseline = NULL;
+    if (baseline_path && !(baseline = baseline_load(baseline_path))) return 1;
+    int regressions = 0;
+
+    if (mode == MODE_NONE || (mode == MODE_PAIR && (cpu1 == -1 || cpu2 == -1))) {
         // Default to Matrix if no args? Or just show help? 
         // Let's default to matrix if nothing specified is usually nice, but let's strictly follow flags.
         // If nothing, print help.
@@ -199,35 +1630,316 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    if (mode_matrix) {
-        long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
-        printf("Measuring core-to-core latency for %ld cores...\n", num_cores);
-        
-        // Print Header
-        printf("      ");
-        for (int j = 0; j < num_cores; j++) {
-            printf(" %5d", j);
+    if (topo_init() != 0) {
+        fprintf(stderr, "Warning: could not read CPU topology, isolation disabled\n");
+    }
+
+    // Usable CPUs (online, in our affinity mask, in -C) in topology order
+    int *cpus;
+    int num_cores = cpuset_build(cpulist, &cpus);
+    if (num_cores < 0) return 1;
+    if (num_cores == 0) {
+        fprintf(stderr, "No usable CPUs%s\n", cpulist ? " in the given CPU list" : "");
+        return 1;
+    }
+    topo_sort(cpus, num_cores);
+
+    if (mode == MODE_PAIR && cpu1 == cpu2) {
+        fprintf(stderr, "The two CPUs of a pair must differ\n");
+        return 1;
+    }
+    if (mode == MODE_PAIR && (!cpuset_contains(cpu1) || !cpuset_contains(cpu2))) {
+        fprintf(stderr, "CPU %d or %d is offline or outside the affinity mask\n", cpu1, cpu2);
+        return 1;
+    }
+
+    if (mode == MODE_TOPOLOGY) {
+        topo_print(cpus, num_cores);
+        return 0;
+    }
+
+    if (mode == MODE_PAIR) {
+        int pair[2] = {cpu1, cpu2};
+        if (pool_init(pair, 2) != 0) return 1;
+    } else {
+        if (pool_init(cpus, num_cores) != 0) return 1;
+    }
+
+    int invariant = tsc_invariant();
+    tsc_calibrate();
+    printf("TSC: %.3f GHz (%s)\n", tsc_hz / 1e9,
+           invariant > 0 ? "invariant" : invariant == 0 ? "NOT invariant" : "invariance unknown");
+    if (invariant == 0) {
+        fprintf(stderr, "Warning: TSC is not invariant, nanosecond values depend on the current clock\n");
+    }
+    if (use_perf && (mode == MODE_PAIR || mode == MODE_MATRIX) && perf_init() == 0) {
+        fprintf(stderr, "Warning: no perf events available, continuing without counters\n");
+    }
+
+    if (noise_check && (mode == MODE_PAIR || mode == MODE_MATRIX) && noise_init() != 0) {
+        noise_check = 0;
+    }
+
+    // Matrix cells: one-way latency in the requested unit
+    // rfo and broadcast samples are one-way already, the others round trips
+    double one_way = (pattern == PATTERN_RFO || pattern == PATTERN_BROADCAST ||
+                      pattern == PATTERN_ONEWAY) ? 1.0 : ONE_WAY;
+    double scale = unit_ns ? one_way * 1e9 / tsc_hz : one_way;
+    if (pattern != PATTERN_STORE && (mode == MODE_PAIR || mode == MODE_MATRIX)) {
+        printf("Access pattern: %s\n", pattern_desc[pattern]);
+    }
+    if (pattern == PATTERN_ONEWAY && (mode == MODE_PAIR || mode == MODE_MATRIX)) {
+        char *cs = read_line_file("/sys/devices/system/clocksource/clocksource0/current_clocksource");
+        if (invariant == 0 || (cs && strcmp(cs, "tsc") != 0)) {
+            fprintf(stderr, "Warning: the kernel does not use the TSC as clocksource (%s), "
+                    "TSCs may not be synchronized across cores\n", cs ? cs : "unknown");
         }
-        printf("\n");
-        
+        free(cs);
+    }
+    // Round trips are symmetric: measure one direction and mirror it
+    int half = !full_matrix && !bw_size && pattern != PATTERN_RFO && pattern != PATTERN_ONEWAY;
+
+    if (wake_mask && (mode == MODE_PAIR || mode == MODE_MATRIX)) {
+        run_wakeup_mode(cpus, num_cores, wake_mask, spin_ns, nspins,
+                        mode == MODE_PAIR ? cpu1 : -1, cpu2, parallel, isolate, scale, stat,
+                        unit_ns ? "ns" : "cycles");
+    } else if (ring && (mode == MODE_PAIR || mode == MODE_MATRIX)) {
+        run_ring_mode(cpus, num_cores, mode == MODE_PAIR ? cpu1 : -1, cpu2,
+                      parallel, isolate, scale, stat, unit_ns ? "ns" : "cycles");
+    } else if (lock_mask && (mode == MODE_PAIR || mode == MODE_MATRIX)) {
+        run_locks(cpus, num_cores, lock_mask, mode == MODE_PAIR ? cpu1 : -1, cpu2,
+                  parallel, isolate, scale, stat, unit_ns ? "ns" : "cycles");
+    } else if (mode == MODE_CONTENTION) {
+        run_contention(cpus, num_cores, contention_op, sweep_step, unit_ns);
+    } else if (mode == MODE_NUMA) {
+        run_numa(cpus, num_cores, chase_size ? chase_size : (size_t)256 << 20, hugepages, stat);
+    } else if (mode == MODE_TOKEN_RING) {
+        int *set = cpus, nset = num_cores;
+        if (ring_order) {
+            set = malloc(num_cores * sizeof(int));
+            if (!set) { perror("malloc"); return 1; }
+            nset = 0;
+            for (const char *p = ring_order; *p; ) {
+                char *end;
+                int cpu = strtol(p, &end, 10);
+                int dup = 0;
+                for (int k = 0; k < nset; k++) dup |= set[k] == cpu;
+                if (end == p || (*end && *end != ',') || dup || nset == num_cores ||
+                    !cpuset_contains(cpu)) {
+                    fprintf(stderr, "Invalid ring order '%s' (unknown, unusable or repeated CPU)\n",
+                            ring_order);
+                    free(set);
+                    return 1;
+                }
+                set[nset++] = cpu;
+                p = *end ? end + 1 : end;
+            }
+        }
+        if (nset < 2) {
+            fprintf(stderr, "A token ring needs at least 2 CPUs\n");
+            if (set != cpus) free(set);
+            return 1;
+        }
+
+        double *lat = NULL;
+        if (optimize) {
+            pair_result_t *res = calloc((size_t)nset * nset, sizeof(pair_result_t));
+            lat = malloc((size_t)nset * nset * sizeof(double));
+            if (!res || !lat) { perror("malloc"); return 1; }
+            printf("Measuring pairwise latency for %d cores...\n", nset);
+            run_matrix_parallel(set, nset, isolate, !full_matrix, res, run_batch, NULL);
+            for (int k = 0; k < nset * nset; k++) {
+                const lat_hist_t *h = &res[k].hist;
+                // p50 like --place: a few preempted samples do not steer the order
+                lat[k] = h->n ? hist_percentile(h, 50.0) * one_way : 1e18;  // avoid unmeasured hops
+            }
+            free(res);
+        }
+        run_token_ring(set, nset, ring_order ? "given order" : "topology order", lat, unit_ns);
+        free(lat);
+        if (set != cpus) free(set);
+    } else if (mode == MODE_PLACE) {
+        // Candidates: selected CPUs on the allowed nodes (and in the matrix file)
+        unsigned char node_mask[1024] = {0};
+        if (place_nodes && cpulist_parse(place_nodes, node_mask, 1024, "node") <= 0) {
+            fprintf(stderr, "Invalid node list '%s'\n", place_nodes);
+            return 1;
+        }
+        baseline_t *cached = NULL;
+        if (matrix_path && !(cached = baseline_load(matrix_path))) return 1;
+
+        int *cand = malloc(num_cores * sizeof(int));
+        int ncand = 0;
+        if (!cand) { perror("malloc"); return 1; }
         for (int i = 0; i < num_cores; i++) {
-            printf("%5d ", i);
-            for (int j = 0; j < num_cores; j++) {
-                if (i == j) {
-                    printf("     -");
-                    continue;
+            int node = topo_cpu(cpus[i])->node;
+            if (place_nodes && (node < 0 || node >= 1024 || !node_mask[node])) continue;
+            int known = !cached;
+            for (int j = 0; j < num_cores && !known; j++) {
+                known = j != i && baseline_latency_ns(cached, cpus[i], cpus[j]) >= 0;
+            }
+            if (known) cand[ncand++] = cpus[i];
+        }
+        if (ncand == 0) {
+            fprintf(stderr, "No candidate CPUs%s\n", place_nodes ? " on the given nodes" : "");
+            return 1;
+        }
+
+        double *lat = malloc((size_t)ncand * ncand * sizeof(double));
+        if (!lat) { perror("malloc"); return 1; }
+        if (cached) {
+            printf("Latencies from %s\n", matrix_path);
+            for (int i = 0; i < ncand; i++) {
+                for (int j = 0; j < ncand; j++) {
+                    lat[i * ncand + j] = i == j ? 0 : baseline_latency_ns(cached, cand[i], cand[j]);
                 }
-                double latency = run_benchmark(i, j);
-                printf(" %5.0f", latency);
-                fflush(stdout);
             }
-            printf("\n");
+            baseline_free(cached);
+        } else {
+            pair_result_t *res = calloc((size_t)ncand * ncand, sizeof(pair_result_t));
+            if (!res) { perror("calloc"); return 1; }
+            printf("Measuring pairwise latency for %d cores...\n", ncand);
+            run_matrix_parallel(cand, ncand, isolate, !full_matrix, res, run_batch, NULL);
+            for (int k = 0; k < ncand * ncand; k++) {
+                const lat_hist_t *h = &res[k].hist;
+                lat[k] = h->n ? hist_percentile(h, 50.0) * one_way * 1e9 / tsc_hz : -1;
+            }
+            free(res);
+        }
+        int err = run_place(place_graph, cand, ncand, lat, no_smt);
+        free(lat);
+        free(cand);
+        if (err) return 1;
+    } else if (mode == MODE_CACHE_SWEEP) {
+        run_cache_sweep(cpus[0], chase_size, hugepages);
+    } else if (mode == MODE_STREAM) {
+        int mem_nodes[1024];
+        int nmem = 0;
+        if (mem_node_list) {
+            unsigned char mask[1024] = {0};
+            if (cpulist_parse(mem_node_list, mask, 1024, "node") <= 0) {
+                fprintf(stderr, "Invalid memory node list '%s'\n", mem_node_list);
+                return 1;
+            }
+            for (int i = 0; i < 1024; i++) {
+                if (mask[i]) mem_nodes[nmem++] = i;
+            }
+        } else {
+            nmem = numa_mem_nodes(mem_nodes, 1024);
+        }
+        if (hugepages) stream_size = (stream_size + (2 << 20) - 1) & ~(size_t)((2 << 20) - 1);
+        run_stream(cpus, num_cores, stream_size,
+                   (stream_kernel_t)(stream_kernel >= 0 ? stream_kernel : stream_kernel_best()),
+                   bw_nontemporal, nthreads, mem_nodes, nmem, hugepages);
+    } else if (mode == MODE_FALSE_SHARING) {
+        if (nthreads == 1 || num_cores < 2) {
+            fprintf(stderr, "False sharing needs at least 2 threads on 2 CPUs\n");
+            return 1;
+        }
+        if (nthreads > num_cores) {
+            fprintf(stderr, "--threads %d exceeds the %d usable CPUs\n", nthreads, num_cores);
+            return 1;
         }
+        run_falseshare(cpus, num_cores, nthreads ? nthreads : 2, strides, nstrides, unit_ns);
+    } else if (mode == MODE_MATRIX) {
+        const char *unit = unit_ns ? "ns" : "cycles";
+        pair_result_t *res = calloc((size_t)num_cores * num_cores, sizeof(pair_result_t));
+        if (!res) { perror("calloc"); return 1; }
+
+        for (int h = 0; h < nhomes; h++) {
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            home_node = homes[h];
+            if (home_node >= 0) printf("\nShared line on node %d\n", home_node);
+
+            if (pattern == PATTERN_BROADCAST) {
+                printf("Measuring broadcast latency for %d cores...\n", num_cores);
+                run_broadcast_matrix(cpus, num_cores, res, scale, stat);
+                printf("Matrix cells: %s latency in %s, row = writer, column = reader\n",
+                       stat_name(stat), unit);
+            } else {
+                printf("Measuring core-to-core latency for %d cores%s...\n", num_cores,
+                       parallel ? " (parallel sweep)" : "");
+                run_matrix(cpus, num_cores, parallel, isolate, half, res, run_batch, NULL,
+                           scale, stat);
+                printf("Matrix cells: one-way %s latency in %s%s\n", stat_name(stat), unit,
+                       half ? ", j -> i mirrors i -> j (--full measures both)" : "");
+            }
+            if (pattern == PATTERN_ONEWAY) print_asymmetry_matrix(cpus, num_cores, res, scale, stat);
+            if (bw_size) print_bw_matrix(cpus, num_cores, res);
+            if (adapt_rel_err > 0) print_batch_matrix(cpus, num_cores, res);
+            if (perf_enabled && pattern != PATTERN_BROADCAST) {
+                print_perf_matrix(cpus, num_cores, res);
+            }
+            print_tier_summary(cpus, num_cores, res, scale, unit);
+            if (noise_check && pattern != PATTERN_BROADCAST) {
+                print_noisy_pairs(cpus, num_cores, res);
+            }
+
+            matrix_out_t out = {cpus, num_cores, res, one_way, pattern_names[pattern],
+                                home_node, noise_check && pattern != PATTERN_BROADCAST,
+                                argc, argv};
+            if (json_path && write_json(json_path, &out) != 0) return 1;
+            if (csv_path && write_csv(csv_path, &out) != 0) return 1;
+            if (heatmap_path && write_heatmap(heatmap_path, &out, stat, unit_ns) != 0) return 1;
+            if (baseline) {
+                int r = baseline_compare(baseline, &out, regress_pct);
+                if (r < 0) return 1;
+                regressions += r;
+            }
+            printf("Matrix completed in %.1f s\n", elapsed_sec(&start));
+        }
+        free(res);
     } else {
-        printf("Measuring latency between core %d and %d...\n", cpu1, cpu2);
-        double latency = run_benchmark(cpu1, cpu2);
-        printf("Latency: %.2f cycles\n", latency);
+        pair_result_t *res = calloc(2, sizeof(pair_result_t));    // [1]: oneway reverse
+        if (!res) { perror("calloc"); return 1; }
+        for (int h = 0; h < nhomes; h++) {
+            home_node = homes[h];
+            printf("%sMeasuring latency between core %d and %d", h ? "\n" : "", cpu1, cpu2);
+            if (home_node >= 0) printf(", shared line on node %d", home_node);
+            printf("...\n");
+            if (run_benchmark(cpu1, cpu2, res) != 0) {
+                fprintf(stderr, "Could not pin to CPU %d and %d\n", cpu1, cpu2);
+                return 1;
+            }
+
+            lat_stats_t st;
+            hist_stats(&res->hist, one_way, &st);
+            printf("Latency: %.2f cycles (%.2f ns)\n", st.mean, st.mean * 1e9 / tsc_hz);
+            print_distribution(&st);
+            if (adapt_rel_err > 0) {
+                printf("Batches: %d x %d round trips\n", res->batches, adapt_batch_len);
+            }
+            if (perf_enabled) print_perf_pair(res);
+            if (noise_check) {
+                printf("Noise: %llu interrupts, %u involuntary switches, %d reruns%s\n",
+                       (unsigned long long)res->noise_irqs, res->noise_csw[0] + res->noise_csw[1],
+                       res->reruns, res->noisy ? " (noisy)" : "");
+            }
+            if (pattern == PATTERN_ONEWAY && run_benchmark(cpu2, cpu1, &res[1]) == 0) {
+                lat_stats_t back;
+                hist_stats(&res[1].hist, one_way, &back);
+                printf("Reverse %d -> %d: %.2f cycles (%.2f ns)\n", cpu2, cpu1, back.mean,
+                       back.mean * 1e9 / tsc_hz);
+                printf("Mean of both directions: %.2f cycles, half-difference %+.2f cycles "
+                       "(path asymmetry plus TSC offset)\n",
+                       (st.mean + back.mean) / 2, (st.mean - back.mean) / 2);
+            }
+        }
+        if (bw_size && run_bandwidth(cpu1, cpu2, res) == 0) {
+            double ns = res->bw_cycles / tsc_hz * 1e9 / res->bw_rounds;
+            printf("Bandwidth %d -> %d: %.2f GB/s (%zu bytes per transfer%s, %.1f ns each)\n",
+                   cpu1, cpu2, bw_gbps(res), bw_size,
+                   bw_nontemporal ? ", non-temporal stores" : "", ns);
+        }
+        free(res);
+    }
+    if (noise_check && (mode == MODE_PAIR || mode == MODE_MATRIX)) {
+        noise_report(cpus, num_cores);
     }
 
-    return 0;
+    pool_destroy();
+    baseline_free(baseline);
+    free(cpus);
+    return regressions > 0 ? 2 : 0;
 }
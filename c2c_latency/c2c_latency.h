@@ -0,0 +1,404 @@
+#ifndef C2C_LATENCY_H
+#define C2C_LATENCY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+
+// Cache line size is typically 64 bytes.
+// We align structures to avoid false sharing.
+#define CACHE_LINE_SIZE 64
+
+// Helper to get RDTSC
+static inline uint64_t rdtsc(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Fenced TSC reads for the boundaries of a timed region: rdtsc_start()
+// cannot move up into preceding code or let the timed code start early,
+// rdtsc_end() waits for the timed code to finish (rdtscp) and keeps later
+// instructions from starting before the read.
+static inline uint64_t rdtsc_start(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("lfence\n\trdtsc\n\tlfence" : "=a" (lo), "=d" (hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t rdtsc_end(void) {
+    unsigned int lo, hi, aux;
+    __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a" (lo), "=d" (hi), "=c" (aux) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Unfenced read between consecutive samples of one timed region. It only
+// keeps the compiler from moving it; the CPU may execute it a little early
+// or late, but the error moves time between neighbouring samples and the
+// fenced reads at the region's ends keep the total exact.
+static inline uint64_t rdtsc_lap(void) {
+    unsigned int lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void cpu_relax(void) {
+    __asm__ __volatile__ ("pause" ::: "memory");
+}
+
+static inline void futex_wait(volatile uint32_t *addr, uint32_t val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void futex_wake(volatile uint32_t *addr, int nr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, nr, NULL, NULL, 0);
+}
+
+// Work item for the worker pool. fn runs once on each of nthreads pinned
+// workers with role 0..nthreads-1; embed the job in a larger struct to
+// pass arguments.
+typedef struct pool_job pool_job_t;
+struct pool_job {
+    void (*fn)(pool_job_t *job, int role);
+    int nthreads;
+    volatile uint32_t ready __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint32_t done __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+// Log-bucketed latency histogram.
+// Values below HIST_SUB are exact; above that every power of two is split
+// into HIST_SUB linear sub-buckets (~3% relative resolution). Values of
+// 2^HIST_MAX_BITS cycles and more land in the last bucket.
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 32
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];   // 64-bit: merged tier histograms pass 2^32
+    uint64_t n;
+    uint64_t min, max;
+    double sum;
+} lat_hist_t;
+
+// Summary of a histogram, already multiplied by the caller's scale factor
+typedef struct {
+    double mean, min, p50, p90, p99, p999, max;
+} lat_stats_t;
+
+// Statistic shown in matrix cells (-s)
+typedef enum {
+    STAT_MEAN, STAT_MIN, STAT_P50, STAT_P90, STAT_P99, STAT_P999, STAT_MAX
+} stat_t;
+
+static inline int hist_index(uint64_t v) {
+    if (v < HIST_SUB) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    if (e >= HIST_MAX_BITS) return HIST_BUCKETS - 1;
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+// Hot path: kept inline and branch-light so it can sit in a timed loop
+static inline void hist_record(lat_hist_t *h, uint64_t v) {
+    h->counts[hist_index(v)]++;
+    h->n++;
+    h->sum += (double)v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+// Hardware counters of one measured thread (perf.c)
+typedef enum {
+    PERF_CYCLES, PERF_INSTRUCTIONS, PERF_REF_CYCLES, PERF_LLC_MISSES,
+    PERF_CTX_SWITCHES, PERF_RAW, PERF_NUM_EVENTS
+} perf_event_t;
+
+typedef struct {
+    uint64_t val[PERF_NUM_EVENTS];
+    uint32_t valid;         // bit per counted event
+    uint64_t ops;           // round trips counted
+    double running;         // share of enabled time the group was on the PMU;
+                            // below 1 the values are scaled up (multiplexed)
+} perf_counts_t;
+
+// Result of one ordered pair measurement
+typedef struct {
+    lat_hist_t hist;        // round-trip cycles
+    int batches;            // timed batches run (1 unless adaptive)
+    uint64_t bw_cycles;     // bandwidth mode: cycles for bw_rounds transfers
+    uint64_t bw_rounds;
+    uint64_t ring_cycles;   // SPSC ring mode: cycles for ring_msgs messages
+    uint64_t ring_msgs;
+    perf_counts_t perf[2];  // --perf: leader, follower
+    uint64_t noise_irqs;    // --noise: interrupts + softirqs on both CPUs
+    uint32_t noise_csw[2];  // --noise: involuntary context switches, leader, follower
+    int noisy;              // --noise: still noisy after the last rerun
+    int reruns;
+    int mirrored;           // half matrix: copied from the opposite direction
+} pair_result_t;
+
+// One unordered pair scheduled by run_matrix_parallel(): a batch runner
+// measures a -> b into res_ab and b -> a into res_ba for every job
+// (a -> b only if res_ba is NULL)
+typedef struct {
+    int a, b;
+    pair_result_t *res_ab, *res_ba;
+} pair_job_t;
+typedef void (*batch_fn_t)(pair_job_t *jobs, int count, void *arg);
+
+// Access patterns of the ping-pong (c2c_latency.c, broadcast.c)
+typedef enum {
+    PATTERN_STORE, PATTERN_LOAD, PATTERN_RFO, PATTERN_CAS, PATTERN_XCHG,
+    PATTERN_BROADCAST, PATTERN_ONEWAY, NUM_PATTERNS
+} pattern_t;
+
+// Lock implementations for the handoff benchmark (locks.c)
+typedef enum {
+    LOCK_TAS, LOCK_TICKET, LOCK_MCS, LOCK_FUTEX, NUM_LOCK_TYPES
+} lock_type_t;
+
+// Wakeup mechanisms for the blocking wakeup benchmark (wakeup.c)
+typedef enum {
+    WAKE_FUTEX, WAKE_EVENTFD, WAKE_PIPE, WAKE_CONDVAR, NUM_WAKE_TYPES
+} wake_type_t;
+
+typedef struct {
+    wake_type_t type;
+    uint64_t spin_cycles;   // spin this long before blocking, 0 = block at once
+} wake_cfg_t;
+
+// STREAM kernels and instruction set flavours (stream.c)
+typedef enum {
+    STREAM_COPY, STREAM_SCALE, STREAM_ADD, STREAM_TRIAD, NUM_STREAM_OPS
+} stream_op_t;
+
+typedef enum {
+    STREAM_SCALAR, STREAM_AVX2, STREAM_AVX512, NUM_STREAM_KERNELS
+} stream_kernel_t;
+
+// Bandwidth transfer job (bandwidth.c)
+typedef struct {
+    pool_job_t job;
+    void *ctrl;
+    uint64_t *buf;
+    int rounds;
+    pair_result_t *res;
+} bw_t;
+
+// Operations for the single-line contention benchmark
+typedef enum {
+    OP_STORE, OP_XADD, OP_CAS, OP_READ_MOSTLY, NUM_CONTENTION_OPS
+} contention_op_t;
+
+// Per-CPU topology as read from /sys/devices/system/cpu/cpuN
+typedef struct {
+    int package;    // physical_package_id, -1 if unknown
+    int die;        // die_id, -1 if unknown
+    int l3;         // lowest CPU id sharing this CPU's L3, -1 if unknown
+    int core;       // core_id, -1 if unknown
+    int node;       // NUMA node, -1 if unknown
+} cpu_topo_t;
+
+// One data or unified cache level as seen by a CPU (sysfs)
+typedef struct {
+    int level;
+    size_t size;            // bytes
+    int shared;             // CPUs sharing it
+} cache_info_t;
+
+// Relationship between two CPUs, closest first
+typedef enum {
+    TIER_SMT,           // SMT siblings of one core
+    TIER_L3,            // same L3 domain
+    TIER_SOCKET,        // different L3, same package
+    TIER_CROSS_SOCKET,  // different packages
+    NUM_TIERS
+} tier_t;
+
+// Domains used to keep concurrently measured pairs apart
+typedef enum {
+    ISOLATE_NONE,
+    ISOLATE_SOCKET,
+    ISOLATE_L3
+} isolate_t;
+
+// c2c_latency.c
+#ifndef ITERATIONS
+#define ITERATIONS 100000
+#endif
+int pin_thread_to_core(int core_id);
+size_t parse_size(const char *arg);
+void run_matrix_parallel(const int *cpus, int n, isolate_t isolate, int half,
+                         pair_result_t *res, batch_fn_t batch_fn, void *arg);
+
+// pool.c
+int pool_init(const int *cpus, int n);
+void pool_destroy(void);
+int pool_dispatch(pool_job_t *job, const int *cpus);
+void pool_wait(pool_job_t *job);
+void job_sync(pool_job_t *job);
+
+// bandwidth.c
+extern size_t bw_size;
+extern int bw_nontemporal;
+int bw_start(bw_t *bw, int src, int dst, pair_result_t *res);
+void bw_finish(bw_t *bw);
+int run_bandwidth(int src, int dst, pair_result_t *res);
+double bw_gbps(const pair_result_t *res);
+
+// broadcast.c
+int run_broadcast_row(const int *cpus, int n, int writer, int home, pair_result_t *row);
+
+// contention.c
+int contention_op_parse(const char *name);
+void run_contention(const int *cpus, int n, contention_op_t op, int step, int unit_ns);
+
+// falseshare.c
+void run_falseshare(const int *cpus, int n, int nthreads, const int *strides,
+                    int nstrides, int unit_ns);
+
+// locks.c
+int lock_type_parse(const char *name);
+const char *lock_type_name(lock_type_t type);
+int run_lock_handoff(lock_type_t type, int cpu1, int cpu2, pair_result_t *res);
+void lock_batch(pair_job_t *jobs, int count, void *arg);
+double lock_handoffs_per_sec(const pair_result_t *res);
+
+// spsc.c
+extern size_t ring_msg_size;
+extern int ring_depth;
+extern int ring_batch;
+extern int ring_naive;
+int run_ring(int producer, int consumer, pair_result_t *res);
+void ring_pair_batch(pair_job_t *jobs, int count, void *arg);
+double ring_msgs_per_sec(const pair_result_t *res);
+
+// wakeup.c
+int wake_type_parse(const char *name);
+const char *wake_type_name(wake_type_t type);
+int run_wakeup(const wake_cfg_t *cfg, int cpu1, int cpu2, pair_result_t *res);
+void wake_batch(pair_job_t *jobs, int count, void *arg);
+
+// numa.c
+#define CHASE_CHUNK 1024        // dependent loads per chase_run() sample
+void *numa_alloc(size_t size, int node, int hugepages);
+void numa_free(void *buf, size_t size);
+void chase_build(void *buf, size_t size, unsigned seed);
+int chase_run(int cpu, void *chain, pair_result_t *res);
+int numa_mem_nodes(int *nodes, int max);
+void run_numa(const int *cpus, int n, size_t size, int hugepages, stat_t stat);
+
+// cache.c
+void run_cache_sweep(int cpu, size_t max_size, int hugepages);
+
+// stream.c
+int stream_kernel_parse(const char *name);
+int stream_kernel_best(void);
+int stream_kernel_supported(stream_kernel_t k);
+void run_stream(const int *cpus, int n, size_t size, stream_kernel_t kernel, int nt,
+                int nthreads, const int *mem_nodes, int nmem, int hugepages);
+
+// perf.c
+extern int perf_enabled;
+extern uint64_t perf_raw_config;
+int perf_init(void);
+const char *perf_event_name(perf_event_t event);
+int perf_event_available(perf_event_t event);
+void perf_begin(void);
+void perf_start(void);
+void perf_end(perf_counts_t *out, uint64_t ops);
+int perf_scaled(const perf_counts_t *c);
+double perf_per_op(const perf_counts_t *c, perf_event_t event);
+
+// output.c
+typedef struct {
+    char hostname[256];
+    struct utsname uts;
+    char *cpu_model;
+    char *microcode;
+    char *governor;
+} host_info_t;
+void host_info(host_info_t *h, int cpu);
+void host_free(host_info_t *h);
+
+// A finished matrix for --json, --csv, --heatmap and --baseline
+typedef struct {
+    const int *cpus;
+    int n;
+    const pair_result_t *res;   // res[i * n + j]: cpus[i] -> cpus[j]
+    double one_way;             // recorded sample -> one-way cycles
+    const char *pattern;
+    int home_node;
+    int noise;                  // noise fields are valid
+    int argc;
+    char **argv;
+} matrix_out_t;
+int write_json(const char *path, const matrix_out_t *m);
+int write_csv(const char *path, const matrix_out_t *m);
+int write_heatmap(const char *path, const matrix_out_t *m, stat_t stat, int unit_ns);
+
+// tokenring.c
+void run_token_ring(const int *cpus, int n, const char *label, const double *lat,
+                    int unit_ns);
+
+// baseline.c
+typedef struct baseline baseline_t;
+baseline_t *baseline_load(const char *path);
+void baseline_free(baseline_t *b);
+int baseline_compare(const baseline_t *b, const matrix_out_t *m, double threshold_pct);
+double baseline_latency_ns(const baseline_t *b, int from, int to);
+
+// place.c
+int run_place(const char *graph_path, const int *cpus, int n, const double *lat, int no_smt);
+
+// noise.c
+typedef struct noise_snap noise_snap_t;
+int noise_init(void);
+noise_snap_t *noise_snapshot(void);
+void noise_free(noise_snap_t *s);
+uint64_t noise_cpu_events(const noise_snap_t *a, const noise_snap_t *b, int cpu);
+void noise_account(const noise_snap_t *a, const noise_snap_t *b, int cpu, uint64_t csw,
+                   int noisy);
+void noise_report(const int *cpus, int n);
+
+// hist.c
+void hist_init(lat_hist_t *h);
+void hist_merge(lat_hist_t *dst, const lat_hist_t *src);
+double hist_percentile(const lat_hist_t *h, double pct);
+void hist_stats(const lat_hist_t *h, double scale, lat_stats_t *s);
+int stat_parse(const char *name);
+double stat_value(const lat_stats_t *s, stat_t stat);
+const char *stat_name(stat_t stat);
+double median_ci_rel_err(const double *medians, int k);
+double hist_ks_distance(const lat_hist_t *a, double scale_a, const lat_hist_t *b,
+                        double scale_b);
+
+// tsc.c
+extern double tsc_hz;       // calibrated TSC frequency, 0 until tsc_calibrate()
+int tsc_invariant(void);
+double tsc_calibrate(void);
+
+// topology.c
+int topo_init(void);
+const cpu_topo_t *topo_cpu(int cpu);
+int topo_domain(int cpu, isolate_t isolate);
+tier_t topo_tier(int a, int b);
+const char *tier_name(tier_t tier);
+void topo_sort(int *cpus, int n);
+void topo_print(const int *cpus, int n);
+int read_int_file(const char *path, int *val);
+char *read_line_file(const char *path);
+int cpulist_parse(const char *list, unsigned char *mask, int max, const char *what);
+int cpuset_build(const char *cpulist, int **cpus);
+int cpuset_contains(int cpu);
+int topo_caches(int cpu, cache_info_t *caches, int max);
+
+#endif
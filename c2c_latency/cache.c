@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <math.h>
+
+// Cache hierarchy latency curve.
+// The working set grows from 4 KiB in quarter-octave steps; at each size
+// the chosen core runs the random pointer chase from numa.c over the first
+// size bytes of one buffer (dependent-load latency) and then reads them
+// sequentially (streaming bandwidth). Each cache level shows up as a
+// plateau of the latency curve; the size where a plateau ends is that
+// level's effective capacity, which is compared with sysfs. An effective
+// L3 well below the sysfs size points at cache allocation (CAT) or a noisy
+// neighbour.
+
+#define SWEEP_MIN_SIZE (4 << 10)
+#define SWEEP_STEPS_PER_OCTAVE 4
+#define SWEEP_MAX_POINTS 128
+#define SWEEP_BW_BYTES (64 << 20)       // bytes read per bandwidth rep
+#define SWEEP_BW_REPS 3
+#define KNEE_STEP 1.07                  // step-to-step growth that counts as rising
+#define KNEE_GAP 2                      // flat steps tolerated inside one rise
+#define KNEE_TOTAL 1.5                  // minimum rise of a level transition
+#define MAX_CACHES 8
+
+typedef struct {
+    pool_job_t job;
+    const uint64_t *buf;
+    size_t size;
+    uint64_t best;          // cycles for passes * size bytes
+    int passes;
+    volatile uint64_t sink;
+} sweep_bw_t;
+
+static uint64_t read_sum(const uint64_t *buf, size_t words) {
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t i = 0; i < words; i += 4) {
+        s0 += buf[i];
+        s1 += buf[i + 1];
+        s2 += buf[i + 2];
+        s3 += buf[i + 3];
+    }
+    return s0 + s1 + s2 + s3;
+}
+
+static void sweep_bw_job(pool_job_t *job, int role) {
+    sweep_bw_t *bw = (sweep_bw_t *)job;
+    size_t words = bw->size / sizeof(uint64_t);
+    uint64_t sum = 0;
+    (void)role;
+
+    job_sync(job);
+    sum += read_sum(bw->buf, words);     // warm up
+    for (int r = 0; r < SWEEP_BW_REPS; r++) {
+        uint64_t start = rdtsc_start();
+        for (int p = 0; p < bw->passes; p++) sum += read_sum(bw->buf, words);
+        uint64_t cycles = rdtsc_end() - start;
+        if (r == 0 || cycles < bw->best) bw->best = cycles;
+    }
+    bw->sink = sum;
+}
+
+static double sweep_bandwidth(int cpu, const void *buf, size_t size) {
+    sweep_bw_t bw;
+    memset(&bw, 0, sizeof(bw));
+    bw.buf = buf;
+    bw.size = size;
+    bw.passes = size < SWEEP_BW_BYTES ? SWEEP_BW_BYTES / size : 1;
+    bw.job.fn = sweep_bw_job;
+    bw.job.nthreads = 1;
+    if (pool_dispatch(&bw.job, &cpu) != 0) return 0;
+    pool_wait(&bw.job);
+    return (double)bw.passes * size / (bw.best / tsc_hz) / 1e9;
+}
+
+static void format_size(char *buf, size_t len, size_t size) {
+    if (size >= (1 << 30) && size % (1 << 30) == 0) snprintf(buf, len, "%zuG", size >> 30);
+    else if (size >= (1 << 20)) snprintf(buf, len, "%.3gM", size / 1048576.0);
+    else snprintf(buf, len, "%.3gK", size / 1024.0);
+}
+
+// Level transitions of the latency curve. A transition is a run of steps
+// growing by more than KNEE_STEP (with up to KNEE_GAP flat steps inside)
+// whose total rise is at least KNEE_TOTAL; TLB effects and noise give
+// smaller drifts. Its knee, the capacity of the level below, is the last
+// size before latency crosses the geometric mean of the two plateaus.
+// Returns the number of knees written.
+static int find_knees(const size_t *sizes, const double *lat, int n, size_t *knees, int max) {
+    int nknees = 0;
+    for (int i = 1; i < n && nknees < max; ) {
+        if (lat[i] <= KNEE_STEP * lat[i - 1]) {
+            i++;
+            continue;
+        }
+        int start = i - 1, end = i, gap = 0;
+        for (int j = i + 1; j < n && gap <= KNEE_GAP; j++) {
+            if (lat[j] > KNEE_STEP * lat[j - 1]) {
+                end = j;
+                gap = 0;
+            } else {
+                gap++;
+            }
+        }
+        if (lat[end] >= KNEE_TOTAL * lat[start]) {
+            double mid = sqrt(lat[start] * lat[end]);
+            int k = start + 1;
+            while (lat[k] < mid) k++;
+            knees[nknees++] = sizes[k - 1];
+        }
+        i = end + 1;
+    }
+    return nknees;
+}
+
+void run_cache_sweep(int cpu, size_t max_size, int hugepages) {
+    cache_info_t caches[MAX_CACHES];
+    int ncaches = topo_caches(cpu, caches, MAX_CACHES);
+    if (max_size == 0) {
+        // Several times the last level cache, so the DRAM plateau is reached
+        max_size = ncaches > 0 ? 4 * caches[ncaches - 1].size : (size_t)256 << 20;
+    }
+
+    size_t sizes[SWEEP_MAX_POINTS];
+    int npoints = 0;
+    for (int i = 0; npoints < SWEEP_MAX_POINTS; i++) {
+        double s = SWEEP_MIN_SIZE * pow(2.0, (double)i / SWEEP_STEPS_PER_OCTAVE);
+        size_t size = ((size_t)s + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+        if (size > max_size) break;
+        sizes[npoints++] = size;
+    }
+    size_t alloc = sizes[npoints - 1];
+    if (hugepages) alloc = (alloc + (2UL << 20) - 1) & ~((2UL << 20) - 1);
+    void *buf = numa_alloc(alloc, -1, hugepages);
+    if (!buf) { perror("mmap"); exit(1); }
+    // Fault everything in up front so page faults stay out of the sweep
+    memset(buf, 0, alloc);
+
+    char smin[16], smax[16];
+    format_size(smin, sizeof(smin), sizes[0]);
+    format_size(smax, sizeof(smax), sizes[npoints - 1]);
+    printf("Cache sweep on CPU %d: %s .. %s, %d steps per octave, %s pages\n",
+           cpu, smin, smax, SWEEP_STEPS_PER_OCTAVE, hugepages ? "huge" : "base");
+    printf("     Size  Latency (ns)  Read (GB/s)\n");
+
+    double lat[SWEEP_MAX_POINTS];
+    pair_result_t *res = malloc(sizeof(pair_result_t));
+    if (!res) { perror("malloc"); exit(1); }
+    for (int i = 0; i < npoints; i++) {
+        chase_build(buf, sizes[i], i + 1);
+        if (chase_run(cpu, buf, res) != 0) {
+            fprintf(stderr, "Could not pin to CPU %d\n", cpu);
+            break;
+        }
+        lat_stats_t st;
+        hist_stats(&res->hist, 1e9 / tsc_hz / CHASE_CHUNK, &st);
+        lat[i] = st.p50;
+        double gbps = sweep_bandwidth(cpu, buf, sizes[i]);
+
+        char label[16];
+        format_size(label, sizeof(label), sizes[i]);
+        printf("%9s  %12.2f  %11.1f\n", label, lat[i], gbps);
+        fflush(stdout);
+    }
+    free(res);
+    numa_free(buf, alloc);
+
+    size_t knees[MAX_CACHES];
+    int nknees = find_knees(sizes, lat, npoints, knees, MAX_CACHES);
+    printf("\nLevel   sysfs size  shared by  detected capacity\n");
+    for (int k = 0; k < ncaches || k < nknees; k++) {
+        char sys[16] = "-", det[16] = "-", level[8];
+        if (k < ncaches) {
+            snprintf(level, sizeof(level), "L%d", caches[k].level);
+            format_size(sys, sizeof(sys), caches[k].size);
+        } else {
+            snprintf(level, sizeof(level), "?");
+        }
+        if (k < nknees) format_size(det, sizeof(det), knees[k]);
+        printf("%-6s %11s  %9d  %17s", level, sys, k < ncaches ? caches[k].shared : 0, det);
+        // A knee is only resolved to a quarter octave, so allow one step
+        if (k < ncaches && k < nknees &&
+            knees[k] * pow(2.0, 1.0 / SWEEP_STEPS_PER_OCTAVE) < 0.75 * caches[k].size) {
+            printf("  <- smaller than sysfs");
+        }
+        printf("\n");
+    }
+    if (ncaches > 0 && nknees < ncaches) {
+        printf("Only %d of %d cache levels were detected; widen the sweep with --chase-size\n",
+               nknees, ncaches);
+    }
+    printf("Latency is the p50 of dependent loads; bandwidth is single-core sequential reads.\n");
+}
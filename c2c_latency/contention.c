@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+
+// Many-core contention on a single hot cache line.
+// For N = 1..all selected CPUs (in topology order) N pool workers hammer
+// one line with the chosen operation. Every thread timestamps each op into
+// its own histogram; aggregate throughput is total ops over the span from
+// the first thread starting to the last one finishing.
+
+#define CONTENTION_OPS 20000            // ops per thread and N
+#define READ_MOSTLY_WRITE_EVERY 64      // read-mostly: one xadd per 64 loads
+
+static const char *op_names[NUM_CONTENTION_OPS] = {"store", "xadd", "cas", "read"};
+static const char *op_desc[NUM_CONTENTION_OPS] = {
+    "plain store", "lock xadd", "cmpxchg loop", "read-mostly (1/64 lock xadd)"
+};
+
+typedef struct {
+    lat_hist_t hist;
+    uint64_t start, end;
+} __attribute__((aligned(CACHE_LINE_SIZE))) contention_thread_t;
+
+typedef struct {
+    pool_job_t job;
+    contention_op_t op;
+    volatile uint64_t *line;
+    contention_thread_t *threads;
+} contention_t;
+
+int contention_op_parse(const char *name) {
+    for (int i = 0; i < NUM_CONTENTION_OPS; i++) {
+        if (strcmp(name, op_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static void contention_job(pool_job_t *job, int role) {
+    contention_t *c = (contention_t *)job;
+    contention_thread_t *t = &c->threads[role];
+    volatile uint64_t *line = c->line;
+    uint64_t sink = 0;
+
+    job_sync(job);
+    uint64_t prev = t->start = rdtsc_start();
+    for (int i = 0; i < CONTENTION_OPS; i++) {
+        switch (c->op) {
+            case OP_STORE:
+                *line = i;
+                break;
+            case OP_XADD:
+                __atomic_fetch_add(line, 1, __ATOMIC_SEQ_CST);
+                break;
+            case OP_CAS: {
+                uint64_t old = *line;
+                while (!__atomic_compare_exchange_n(line, &old, old + 1, 0,
+                                                    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                    cpu_relax();
+                }
+                break;
+            }
+            case OP_READ_MOSTLY:
+                if (i % READ_MOSTLY_WRITE_EVERY == role % READ_MOSTLY_WRITE_EVERY) {
+                    __atomic_fetch_add(line, 1, __ATOMIC_SEQ_CST);
+                } else {
+                    sink += *line;
+                }
+                break;
+            default:
+                break;
+        }
+        uint64_t now = rdtsc_end();
+        hist_record(&t->hist, now - prev);
+        prev = now;
+    }
+    t->end = prev;
+    if (sink == 1) __asm__ __volatile__ ("" ::: "memory");
+}
+
+// Sweep N = 1, 1 + step, ... up to n threads and print one row per N
+void run_contention(const int *cpus, int n, contention_op_t op, int step, int unit_ns) {
+    volatile uint64_t *line = aligned_alloc(CACHE_LINE_SIZE, CACHE_LINE_SIZE);
+    contention_t *c = aligned_alloc(CACHE_LINE_SIZE, sizeof(contention_t));
+    c->threads = aligned_alloc(CACHE_LINE_SIZE, n * sizeof(contention_thread_t));
+    lat_hist_t *all = malloc(sizeof(lat_hist_t));
+    if (!line || !c || !c->threads || !all) { perror("malloc"); exit(1); }
+
+    double scale = unit_ns ? 1e9 / tsc_hz : 1.0;
+    printf("Contention: %s on one cache line, %d ops per thread\n", op_desc[op], CONTENTION_OPS);
+    printf("Threads     Mops/s       p50       p90       p99     p99.9       max  (%s per op)\n",
+           unit_ns ? "ns" : "cycles");
+
+    for (int nthreads = 1; nthreads <= n; nthreads += step) {
+        *line = 0;
+        for (int k = 0; k < nthreads; k++) hist_init(&c->threads[k].hist);
+        c->job.fn = contention_job;
+        c->job.nthreads = nthreads;
+        c->op = op;
+        c->line = line;
+        if (pool_dispatch(&c->job, cpus) != 0) {
+            fprintf(stderr, "Could not dispatch to the first %d CPUs\n", nthreads);
+            break;
+        }
+        pool_wait(&c->job);
+
+        uint64_t first = UINT64_MAX, last = 0;
+        hist_init(all);
+        for (int k = 0; k < nthreads; k++) {
+            if (c->threads[k].start < first) first = c->threads[k].start;
+            if (c->threads[k].end > last) last = c->threads[k].end;
+            hist_merge(all, &c->threads[k].hist);
+        }
+        double sec = (last - first) / tsc_hz;
+        lat_stats_t st;
+        hist_stats(all, scale, &st);
+        printf("%7d %10.2f %9.1f %9.1f %9.1f %9.1f %9.1f\n", nthreads,
+               (double)CONTENTION_OPS * nthreads / sec / 1e6,
+               st.p50, st.p90, st.p99, st.p999, st.max);
+        fflush(stdout);
+    }
+
+    free((void *)line);
+    free(c->threads);
+    free(c);
+    free(all);
+}
@@ -0,0 +1,120 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+
+// False-sharing impact.
+// Each thread increments its own counter; counter k lives at byte offset
+// k * stride in one shared buffer, so stride 8 puts all counters in one
+// line, 64 in adjacent lines of one 128-byte prefetcher pair, and 128+ in
+// separate pairs. Samples are taken every FS_SAMPLE_OPS increments so the
+// timer does not swamp cheap uncontended increments.
+
+#define FS_OPS 1000000          // increments per thread
+#define FS_SAMPLE_OPS 64
+#define FS_MAX_STRIDE 4096
+
+typedef struct {
+    lat_hist_t hist;            // cycles per FS_SAMPLE_OPS increments
+    uint64_t start, end;
+} __attribute__((aligned(CACHE_LINE_SIZE))) fs_thread_t;
+
+typedef struct {
+    pool_job_t job;
+    char *buf;
+    int stride;
+    fs_thread_t *threads;
+} falseshare_t;
+
+static void falseshare_job(pool_job_t *job, int role) {
+    falseshare_t *fs = (falseshare_t *)job;
+    fs_thread_t *t = &fs->threads[role];
+    volatile uint64_t *ctr = (volatile uint64_t *)(fs->buf + (size_t)role * fs->stride);
+
+    job_sync(job);
+    uint64_t prev = t->start = rdtsc_start();
+    for (int i = 0; i < FS_OPS / FS_SAMPLE_OPS; i++) {
+        for (int k = 0; k < FS_SAMPLE_OPS; k++) {
+            (*ctr)++;
+        }
+        uint64_t now = rdtsc_end();
+        hist_record(&t->hist, now - prev);
+        prev = now;
+    }
+    t->end = prev;
+}
+
+// Run one layout on the given CPUs and print a result row
+static void fs_run(falseshare_t *fs, const int *cpus, int n, int stride,
+                   const char *label, double scale) {
+    memset(fs->buf, 0, (size_t)n * FS_MAX_STRIDE);
+    for (int k = 0; k < n; k++) hist_init(&fs->threads[k].hist);
+    fs->stride = stride;
+    fs->job.fn = falseshare_job;
+    fs->job.nthreads = n;
+    if (pool_dispatch(&fs->job, cpus) != 0) return;
+    pool_wait(&fs->job);
+
+    lat_hist_t all;
+    uint64_t first = UINT64_MAX, last = 0;
+    hist_init(&all);
+    for (int k = 0; k < n; k++) {
+        if (fs->threads[k].start < first) first = fs->threads[k].start;
+        if (fs->threads[k].end > last) last = fs->threads[k].end;
+        hist_merge(&all, &fs->threads[k].hist);
+    }
+    lat_stats_t st;
+    hist_stats(&all, scale / FS_SAMPLE_OPS, &st);
+
+    char cpustr[64];
+    int len = 0;
+    for (int k = 0; k < n && len < (int)sizeof(cpustr) - 8; k++) {
+        len += snprintf(cpustr + len, sizeof(cpustr) - len, k ? ",%d" : "%d", cpus[k]);
+    }
+    printf("%6d  %-22s %-12s %9.1f %9.2f %9.2f %9.2f\n", stride, label, cpustr,
+           (double)FS_OPS * n / ((last - first) / tsc_hz) / 1e6, st.mean, st.p50, st.p99);
+    fflush(stdout);
+}
+
+// With two threads, measure one representative pair per topology tier;
+// with more, use the first nthreads selected CPUs.
+void run_falseshare(const int *cpus, int n, int nthreads, const int *strides,
+                    int nstrides, int unit_ns) {
+    falseshare_t *fs = aligned_alloc(CACHE_LINE_SIZE, sizeof(falseshare_t));
+    if (!fs) { perror("malloc"); exit(1); }
+    int nt = nthreads;          // 2 <= nthreads <= n, checked by the caller
+    fs->threads = aligned_alloc(CACHE_LINE_SIZE, nt * sizeof(fs_thread_t));
+    fs->buf = aligned_alloc(4096, (size_t)nt * FS_MAX_STRIDE);
+    if (!fs->threads || !fs->buf) { perror("malloc"); exit(1); }
+    double scale = unit_ns ? 1e9 / tsc_hz : 1.0;
+
+    printf("False sharing: %d threads, one counter each, %d increments per thread\n", nt, FS_OPS);
+    printf("Stride  Tier                   CPUs            Mops/s      mean       p50       p99  (%s per increment)\n",
+           unit_ns ? "ns" : "cycles");
+
+    int rep[NUM_TIERS][2];
+    int have[NUM_TIERS] = {0};
+    if (nt == 2) {
+        for (int i = 0; i < n; i++) {
+            for (int j = i + 1; j < n; j++) {
+                tier_t t = topo_tier(cpus[i], cpus[j]);
+                if (have[t]) continue;
+                rep[t][0] = cpus[i];
+                rep[t][1] = cpus[j];
+                have[t] = 1;
+            }
+        }
+    }
+
+    for (int s = 0; s < nstrides; s++) {
+        if (nt == 2) {
+            for (int t = 0; t < NUM_TIERS; t++) {
+                if (have[t]) fs_run(fs, rep[t], 2, strides[s], tier_name(t), scale);
+            }
+        } else {
+            fs_run(fs, cpus, nt, strides[s], "first CPUs", scale);
+        }
+    }
+
+    free(fs->buf);
+    free(fs->threads);
+    free(fs);
+}
@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <math.h>
+
+static const char *stat_names[] = {"mean", "min", "p50", "p90", "p99", "p999", "max"};
+#define NUM_STATS (int)(sizeof(stat_names) / sizeof(stat_names[0]))
+
+void hist_init(lat_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hist_merge(lat_hist_t *dst, const lat_hist_t *src) {
+    if (src->n == 0) return;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->n += src->n;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static void bucket_bounds(int idx, double *low, double *width) {
+    if (idx < HIST_SUB) {
+        *low = idx;
+        *width = 1;
+        return;
+    }
+    int e = idx / HIST_SUB + HIST_SUB_BITS - 1;
+    int sub = idx % HIST_SUB;
+    *width = (double)(1ULL << (e - HIST_SUB_BITS));
+    *low = (HIST_SUB + sub) * *width;
+}
+
+// Percentile (0..100) in raw recorded units, interpolated linearly inside
+// the bucket holding the requested rank and clamped to the exact min/max.
+double hist_percentile(const lat_hist_t *h, double pct) {
+    if (h->n == 0) return 0;
+    double rank = pct / 100.0 * h->n;
+    uint64_t cum = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (h->counts[i] == 0) continue;
+        if (cum + h->counts[i] >= rank) {
+            double low, width;
+            bucket_bounds(i, &low, &width);
+            double v = low + width * (rank - cum) / h->counts[i];
+            if (v < h->min) v = h->min;
+            if (v > h->max) v = h->max;
+            return v;
+        }
+        cum += h->counts[i];
+    }
+    return h->max;
+}
+
+void hist_stats(const lat_hist_t *h, double scale, lat_stats_t *s) {
+    if (h->n == 0) {
+        memset(s, 0, sizeof(*s));
+        return;
+    }
+    s->mean = h->sum / h->n * scale;
+    s->min = h->min * scale;
+    s->p50 = hist_percentile(h, 50.0) * scale;
+    s->p90 = hist_percentile(h, 90.0) * scale;
+    s->p99 = hist_percentile(h, 99.0) * scale;
+    s->p999 = hist_percentile(h, 99.9) * scale;
+    s->max = h->max * scale;
+}
+
+// Map a statistic name ("mean", "p99", ...) to its stat_t, -1 if unknown
+int stat_parse(const char *name) {
+    for (int i = 0; i < NUM_STATS; i++) {
+        if (strcmp(name, stat_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+double stat_value(const lat_stats_t *s, stat_t stat) {
+    switch (stat) {
+        case STAT_MIN:  return s->min;
+        case STAT_P50:  return s->p50;
+        case STAT_P90:  return s->p90;
+        case STAT_P99:  return s->p99;
+        case STAT_P999: return s->p999;
+        case STAT_MAX:  return s->max;
+        default:        return s->mean;
+    }
+}
+
+const char *stat_name(stat_t stat) {
+    return ((int)stat >= 0 && (int)stat < NUM_STATS) ? stat_names[stat] : stat_names[0];
+}
+
+// Two-sample Kolmogorov-Smirnov distance between a (samples times scale_a)
+// and b (times scale_b). The empirical CDFs are only known at bucket upper
+// edges, so both are evaluated as step functions at the union of edges.
+double hist_ks_distance(const lat_hist_t *a, double scale_a, const lat_hist_t *b,
+                        double scale_b) {
+    if (a->n == 0 || b->n == 0) return 0;
+    int ia = 0, ib = 0;
+    uint64_t ca = 0, cb = 0;
+    double d = 0;
+    for (;;) {
+        while (ia < HIST_BUCKETS && a->counts[ia] == 0) ia++;
+        while (ib < HIST_BUCKETS && b->counts[ib] == 0) ib++;
+        if (ia == HIST_BUCKETS && ib == HIST_BUCKETS) break;
+
+        double low, width, ea = INFINITY, eb = INFINITY;
+        if (ia < HIST_BUCKETS) { bucket_bounds(ia, &low, &width); ea = (low + width) * scale_a; }
+        if (ib < HIST_BUCKETS) { bucket_bounds(ib, &low, &width); eb = (low + width) * scale_b; }
+        if (ea <= eb) ca += a->counts[ia++];
+        if (eb <= ea) cb += b->counts[ib++];
+        double diff = fabs((double)ca / a->n - (double)cb / b->n);
+        if (diff > d) d = diff;
+    }
+    return d;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// Relative half-width of the distribution-free 95% confidence interval of
+// the median of k batch medians: the order statistics at ranks
+// k/2 -/+ 1.96*sqrt(k)/2 bound the true median with ~95% probability.
+double median_ci_rel_err(const double *medians, int k) {
+    if (k < 2) return INFINITY;
+    double *sorted = malloc(k * sizeof(double));
+    if (!sorted) return INFINITY;
+    memcpy(sorted, medians, k * sizeof(double));
+    qsort(sorted, k, sizeof(double), compare_double);
+
+    double half = 1.96 * sqrt(k) / 2.0;
+    int lo = (int)floor(k / 2.0 - half);
+    int hi = (int)ceil(k / 2.0 + half);
+    if (lo < 0) lo = 0;
+    if (hi > k - 1) hi = k - 1;
+    double median = (k & 1) ? sorted[k / 2] : (sorted[k / 2 - 1] + sorted[k / 2]) / 2.0;
+    double err = median > 0 ? (sorted[hi] - sorted[lo]) / (2.0 * median) : INFINITY;
+    free(sorted);
+    return err;
+}
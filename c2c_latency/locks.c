@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+
+// Lock handoff latency between two pinned cores.
+// Both threads repeatedly take the same lock. The holder keeps it until
+// the other thread has announced that it is waiting, so every release is
+// a handoff to the other core rather than a re-acquire by the same one.
+// The leader timestamps each of its acquisitions; one sample therefore
+// spans two handoffs (leader -> follower -> leader), reported halved.
+
+#define LOCK_ITERATIONS (ITERATIONS / 10 > 2 ? ITERATIONS / 10 : 2)   // acquisitions per thread
+
+static const char *lock_names[NUM_LOCK_TYPES] = {"tas", "ticket", "mcs", "futex"};
+static const char *lock_desc[NUM_LOCK_TYPES] = {
+    "test-and-test-and-set spinlock", "ticket lock", "MCS queue lock", "futex mutex"
+};
+
+typedef struct mcs_node {
+    struct mcs_node *volatile next;
+    volatile uint32_t locked;
+} __attribute__((aligned(CACHE_LINE_SIZE))) mcs_node_t;
+
+// Per-thread state, each on its own cache line
+typedef struct {
+    mcs_node_t qnode;
+    volatile uint32_t waiting __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint32_t done;
+} lock_thread_t;
+
+typedef struct {
+    volatile uint32_t tas __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint32_t ticket_next __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint32_t ticket_owner;
+    mcs_node_t *volatile mcs_tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint32_t futex __attribute__((aligned(CACHE_LINE_SIZE)));
+    // Data protected by the lock
+    volatile int last_owner __attribute__((aligned(CACHE_LINE_SIZE)));
+    lock_thread_t threads[2];
+} lock_shared_t;
+
+typedef struct {
+    pool_job_t job;
+    lock_type_t type;
+    lock_shared_t *shared;
+    pair_result_t *res;
+} lock_job_t;
+
+int lock_type_parse(const char *name) {
+    for (int i = 0; i < NUM_LOCK_TYPES; i++) {
+        if (strcmp(name, lock_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char *lock_type_name(lock_type_t type) {
+    return lock_desc[type];
+}
+
+static inline void lock_acquire(lock_shared_t *s, lock_type_t type, mcs_node_t *me) {
+    switch (type) {
+        case LOCK_TAS:
+            while (__atomic_exchange_n(&s->tas, 1, __ATOMIC_ACQUIRE)) {
+                while (s->tas) cpu_relax();
+            }
+            break;
+        case LOCK_TICKET: {
+            uint32_t ticket = __atomic_fetch_add(&s->ticket_next, 1, __ATOMIC_RELAXED);
+            while (__atomic_load_n(&s->ticket_owner, __ATOMIC_ACQUIRE) != ticket) cpu_relax();
+            break;
+        }
+        case LOCK_MCS: {
+            me->next = NULL;
+            me->locked = 1;
+            mcs_node_t *pred = __atomic_exchange_n(&s->mcs_tail, me, __ATOMIC_ACQ_REL);
+            if (pred) {
+                pred->next = me;
+                while (__atomic_load_n(&me->locked, __ATOMIC_ACQUIRE)) cpu_relax();
+            }
+            break;
+        }
+        case LOCK_FUTEX: {
+            // Drepper, "Futexes Are Tricky": 0 free, 1 locked, 2 contended
+            uint32_t c = 0;
+            if (__atomic_compare_exchange_n(&s->futex, &c, 1, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                break;
+            }
+            if (c != 2) c = __atomic_exchange_n(&s->futex, 2, __ATOMIC_ACQUIRE);
+            while (c != 0) {
+                futex_wait(&s->futex, 2);
+                c = __atomic_exchange_n(&s->futex, 2, __ATOMIC_ACQUIRE);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static inline void lock_release(lock_shared_t *s, lock_type_t type, mcs_node_t *me) {
+    switch (type) {
+        case LOCK_TAS:
+            __atomic_store_n(&s->tas, 0, __ATOMIC_RELEASE);
+            break;
+        case LOCK_TICKET:
+            __atomic_store_n(&s->ticket_owner, s->ticket_owner + 1, __ATOMIC_RELEASE);
+            break;
+        case LOCK_MCS:
+            if (!me->next) {
+                mcs_node_t *expected = me;
+                if (__atomic_compare_exchange_n(&s->mcs_tail, &expected, NULL, 0,
+                                                __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                    break;
+                }
+                while (!me->next) cpu_relax();
+            }
+            __atomic_store_n(&me->next->locked, 0, __ATOMIC_RELEASE);
+            break;
+        case LOCK_FUTEX:
+            if (__atomic_fetch_sub(&s->futex, 1, __ATOMIC_RELEASE) != 1) {
+                __atomic_store_n(&s->futex, 0, __ATOMIC_RELEASE);
+                futex_wake(&s->futex, 1);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void lock_handoff_job(pool_job_t *job, int role) {
+    lock_job_t *lj = (lock_job_t *)job;
+    lock_shared_t *s = lj->shared;
+    lock_thread_t *me = &s->threads[role];
+    lock_thread_t *peer = &s->threads[role ^ 1];
+    lat_hist_t *hist = &lj->res->hist;
+
+    job_sync(job);
+    uint64_t prev = rdtsc_start();
+    for (int i = 0; i < LOCK_ITERATIONS; ) {
+        me->waiting = 1;
+        lock_acquire(s, lj->type, &me->qnode);
+        me->waiting = 0;
+        if (s->last_owner == role && !peer->done) {
+            // Won the race against our own release: not a handoff. Let the
+            // peer in first.
+            lock_release(s, lj->type, &me->qnode);
+            while (s->last_owner == role && !peer->done) cpu_relax();
+            continue;
+        }
+        s->last_owner = role;
+        i++;
+        if (role == 0) {
+            uint64_t now = rdtsc_end();
+            if (i > 1) hist_record(hist, now - prev);
+            prev = now;
+        }
+        // Hold until the peer queues up so the release hands the lock over
+        while (!peer->waiting && !peer->done) cpu_relax();
+        lock_release(s, lj->type, &me->qnode);
+    }
+    me->done = 1;
+}
+
+// Start a handoff run between cpu1 (timing leader) and cpu2 on the pool
+static int lock_start(lock_job_t *lj, lock_type_t type, int cpu1, int cpu2, pair_result_t *res) {
+    lj->shared = aligned_alloc(CACHE_LINE_SIZE, sizeof(lock_shared_t));
+    if (!lj->shared) { perror("malloc"); exit(1); }
+    memset(lj->shared, 0, sizeof(lock_shared_t));
+    lj->shared->last_owner = -1;
+    hist_init(&res->hist);
+
+    lj->type = type;
+    lj->res = res;
+    lj->job.fn = lock_handoff_job;
+    lj->job.nthreads = 2;
+    int cpus[2] = {cpu1, cpu2};
+    if (pool_dispatch(&lj->job, cpus) != 0) {
+        free(lj->shared);
+        lj->shared = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void lock_finish(lock_job_t *lj) {
+    if (!lj->shared) return;
+    pool_wait(&lj->job);
+    free(lj->shared);
+    lj->shared = NULL;
+}
+
+int run_lock_handoff(lock_type_t type, int cpu1, int cpu2, pair_result_t *res) {
+    lock_job_t lj;
+    if (lock_start(&lj, type, cpu1, cpu2, res) != 0) return -1;
+    lock_finish(&lj);
+    return 0;
+}
+
+// Batch runner for run_matrix_parallel(); arg points at the lock_type_t
+void lock_batch(pair_job_t *jobs, int count, void *arg) {
+    lock_type_t type = *(lock_type_t *)arg;
+    lock_job_t *lj = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(lock_job_t));
+    if (!lj) { perror("malloc"); exit(1); }
+    for (int dir = 0; dir < 2; dir++) {
+        for (int k = 0; k < count; k++) {
+            if (dir == 0) lock_start(&lj[k], type, jobs[k].a, jobs[k].b, jobs[k].res_ab);
+            else if (jobs[k].res_ba) lock_start(&lj[k], type, jobs[k].b, jobs[k].a, jobs[k].res_ba);
+            else lj[k].shared = NULL;
+        }
+        for (int k = 0; k < count; k++) {
+            lock_finish(&lj[k]);
+        }
+    }
+    free(lj);
+}
+
+// Handoffs per second implied by a result (two handoffs per sample)
+double lock_handoffs_per_sec(const pair_result_t *res) {
+    if (res->hist.n == 0) return 0;
+    return 2.0 * res->hist.n / (res->hist.sum / tsc_hz);
+}
@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <time.h>
+
+// Noise accounting (--noise).
+// Per-CPU interrupt and softirq counts are snapshotted from /proc around
+// every batch of pair measurements; the measured threads add their own
+// involuntary context switches. The deltas decide whether a pair was
+// disturbed and are summed per CPU for the final report, together with
+// the interrupt source that hit each CPU most.
+// Rescheduling IPIs are reported but do not make a pair noisy: the pool
+// wakes its workers with a futex, which sends one to an idle CPU anyway.
+
+#define IRQ_NAME_LEN 16
+
+typedef struct {
+    int ncols;
+    int *col_cpu;               // CPU of each column
+    int nlines;
+    char (*names)[IRQ_NAME_LEN];
+    uint64_t *counts;           // nlines x ncols
+} irq_table_t;
+
+struct noise_snap {
+    irq_table_t irq, soft;
+    struct timespec ts;
+};
+
+typedef struct {
+    double seconds;             // time under measurement
+    uint64_t irqs, softirqs, resched, csw;
+    int runs, noisy;
+    int nlines;                 // per-line totals, interrupts then softirqs
+    uint64_t *lines;
+    char (*names)[IRQ_NAME_LEN];
+} noise_cpu_t;
+
+static noise_cpu_t *noise_cpus;
+static int noise_ncpus;
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
+    size_t cap = 65536, len = 0;
+    char *buf = malloc(cap);
+    while (buf) {
+        len += fread(buf + len, 1, cap - len - 1, f);
+        if (len < cap - 1) break;
+        cap *= 2;
+        char *bigger = realloc(buf, cap);
+        if (!bigger) { free(buf); buf = NULL; }
+        else buf = bigger;
+    }
+    fclose(f);
+    if (buf) buf[len] = '\0';
+    return buf;
+}
+
+// Parse /proc/interrupts or /proc/softirqs: a header of CPUn columns, then
+// "NAME: count count ... [description]" lines. Lines with fewer counts
+// than columns (ERR, MIS) are skipped.
+static int irq_read(const char *path, irq_table_t *t) {
+    memset(t, 0, sizeof(*t));
+    char *text = read_file(path);
+    if (!text) return -1;
+
+    char *save, *line = strtok_r(text, "\n", &save);
+    int cap = 64;
+    t->col_cpu = malloc(1024 * sizeof(int));
+    t->names = malloc(cap * sizeof(*t->names));
+    t->counts = NULL;
+    if (!line || !t->col_cpu || !t->names) { free(text); return -1; }
+    for (char *p = line; (p = strstr(p, "CPU")) != NULL && t->ncols < 1024; p += 3) {
+        t->col_cpu[t->ncols++] = atoi(p + 3);
+    }
+    t->counts = malloc((size_t)cap * t->ncols * sizeof(uint64_t));
+
+    while ((line = strtok_r(NULL, "\n", &save)) != NULL && t->counts) {
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        char *p = colon + 1, *end;
+        uint64_t *row = &t->counts[(size_t)t->nlines * t->ncols];
+        int c;
+        for (c = 0; c < t->ncols; c++) {
+            row[c] = strtoull(p, &end, 10);
+            if (end == p) break;
+            p = end;
+        }
+        if (c < t->ncols) continue;
+
+        char *name = line;
+        while (*name == ' ') name++;
+        *colon = '\0';
+        snprintf(t->names[t->nlines], IRQ_NAME_LEN, "%s", name);
+        if (++t->nlines == cap) {
+            cap *= 2;
+            t->names = realloc(t->names, cap * sizeof(*t->names));
+            t->counts = realloc(t->counts, (size_t)cap * t->ncols * sizeof(uint64_t));
+            if (!t->names) break;
+        }
+    }
+    free(text);
+    return t->counts && t->names ? 0 : -1;
+}
+
+static void irq_free(irq_table_t *t) {
+    free(t->col_cpu);
+    free(t->names);
+    free(t->counts);
+}
+
+static int irq_col(const irq_table_t *t, int cpu) {
+    for (int c = 0; c < t->ncols; c++) {
+        if (t->col_cpu[c] == cpu) return c;
+    }
+    return -1;
+}
+
+int noise_init(void) {
+    irq_table_t t;
+    if (irq_read("/proc/interrupts", &t) != 0) {
+        fprintf(stderr, "Cannot read /proc/interrupts, noise detection disabled\n");
+        return -1;
+    }
+    irq_free(&t);
+    noise_ncpus = sysconf(_SC_NPROCESSORS_CONF);
+    noise_cpus = calloc(noise_ncpus, sizeof(noise_cpu_t));
+    return noise_cpus ? 0 : -1;
+}
+
+noise_snap_t *noise_snapshot(void) {
+    noise_snap_t *s = malloc(sizeof(*s));
+    if (!s) return NULL;
+    if (irq_read("/proc/interrupts", &s->irq) != 0) memset(&s->irq, 0, sizeof(s->irq));
+    if (irq_read("/proc/softirqs", &s->soft) != 0) memset(&s->soft, 0, sizeof(s->soft));
+    clock_gettime(CLOCK_MONOTONIC, &s->ts);
+    return s;
+}
+
+void noise_free(noise_snap_t *s) {
+    if (!s) return;
+    irq_free(&s->irq);
+    irq_free(&s->soft);
+    free(s);
+}
+
+// Lines the periodic tick raises on every running CPU: the local timer
+// interrupt and the softirqs it triggers. Only nohz_full avoids them.
+static int tick_line(const char *name) {
+    static const char *ticks[] = {"LOC", "TIMER", "HRTIMER", "SCHED", "RCU"};
+    for (size_t k = 0; k < sizeof(ticks) / sizeof(ticks[0]); k++) {
+        if (strcmp(name, ticks[k]) == 0) return 1;
+    }
+    return 0;
+}
+
+// Sum of per-line deltas of cpu's column; lines[] (if not NULL) gets each
+// line's delta. resched collects the rescheduling IPIs separately. With
+// no_ticks set, tick lines are left out of the sum.
+static uint64_t table_delta(const irq_table_t *a, const irq_table_t *b, int cpu,
+                            uint64_t *lines, uint64_t *resched, int no_ticks) {
+    int ca = irq_col(a, cpu), cb = irq_col(b, cpu);
+    if (ca < 0 || cb < 0 || a->nlines != b->nlines) return 0;
+    uint64_t sum = 0;
+    for (int l = 0; l < b->nlines; l++) {
+        uint64_t d = b->counts[(size_t)l * b->ncols + cb] - a->counts[(size_t)l * a->ncols + ca];
+        if (lines) lines[l] += d;
+        if (resched && strcmp(b->names[l], "RES") == 0) *resched += d;
+        else if (!no_ticks || !tick_line(b->names[l])) sum += d;
+    }
+    return sum;
+}
+
+// Interrupts plus softirqs on cpu between a and b, without rescheduling
+// IPIs and tick lines: a ticking kernel raises those on every pair
+uint64_t noise_cpu_events(const noise_snap_t *a, const noise_snap_t *b, int cpu) {
+    uint64_t resched = 0;
+    return table_delta(&a->irq, &b->irq, cpu, NULL, &resched, 1) +
+           table_delta(&a->soft, &b->soft, cpu, NULL, NULL, 1);
+}
+
+// Add one measurement of cpu between a and b to the per-CPU report
+void noise_account(const noise_snap_t *a, const noise_snap_t *b, int cpu, uint64_t csw,
+                   int noisy) {
+    if (!noise_cpus || cpu < 0 || cpu >= noise_ncpus) return;
+    noise_cpu_t *nc = &noise_cpus[cpu];
+    int nlines = b->irq.nlines + b->soft.nlines;
+    if (!nc->lines) {
+        nc->lines = calloc(nlines, sizeof(uint64_t));
+        nc->names = malloc(nlines * sizeof(*nc->names));
+        if (!nc->lines || !nc->names) return;
+        nc->nlines = nlines;
+        memcpy(nc->names, b->irq.names, b->irq.nlines * sizeof(*nc->names));
+        memcpy(nc->names + b->irq.nlines, b->soft.names, b->soft.nlines * sizeof(*nc->names));
+    }
+    uint64_t *lines = nc->nlines == nlines ? nc->lines : NULL;
+
+    nc->seconds += (b->ts.tv_sec - a->ts.tv_sec) + (b->ts.tv_nsec - a->ts.tv_nsec) / 1e9;
+    nc->irqs += table_delta(&a->irq, &b->irq, cpu, lines, &nc->resched, 0);
+    nc->softirqs += table_delta(&a->soft, &b->soft, cpu, lines ? lines + b->irq.nlines : NULL,
+                                NULL, 0);
+    nc->csw += csw;
+    nc->runs++;
+    nc->noisy += noisy;
+}
+
+void noise_report(const int *cpus, int n) {
+    if (!noise_cpus) return;
+    int header = 0;
+    for (int i = 0; i < n; i++) {
+        if (cpus[i] >= noise_ncpus) continue;
+        noise_cpu_t *nc = &noise_cpus[cpus[i]];
+        if (nc->runs == 0 || nc->seconds <= 0) continue;
+        if (!header++) {
+            printf("\nNoise per core (during its measurements):\n");
+            printf("  CPU   time(s)    irq/s  softirq/s  resched/s  invol.cs  noisy/runs  top source\n");
+        }
+        int top = -1;
+        for (int l = 0; l < nc->nlines; l++) {
+            if (nc->lines[l] && (top < 0 || nc->lines[l] > nc->lines[top])) top = l;
+        }
+        printf("%5d %9.2f %8.1f %10.1f %10.1f %9llu %5d/%-5d  %s\n", cpus[i], nc->seconds,
+               nc->irqs / nc->seconds, nc->softirqs / nc->seconds, nc->resched / nc->seconds,
+               (unsigned long long)nc->csw, nc->noisy, nc->runs, top >= 0 ? nc->names[top] : "-");
+    }
+}
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <sys/mman.h>
+
+// Core-to-memory-node latency by pointer chasing.
+// One buffer per memory node is bound there with mbind() and linked into a
+// single random cycle of cache lines (Sattolo's algorithm), so every load
+// depends on the previous one and neither the prefetchers nor the
+// out-of-order core can overlap them. Each selected core then walks every
+// node's chain. Samples are CHASE_CHUNK loads, reported per load.
+// The raw syscalls keep libnuma out of the build.
+
+#define CHASE_CHUNKS (ITERATIONS / 100 > 4 ? ITERATIONS / 100 : 4)
+#define CHASE_WARMUP_CHUNKS 16
+#define HUGE_PAGE_SIZE (2UL << 20)
+#define MAX_NODES 1024
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+typedef struct {
+    pool_job_t job;
+    void *chain;
+    pair_result_t *res;
+    void *volatile sink;
+} chase_t;
+
+// Map size bytes, bound to node (-1 = default policy), optionally backed by
+// huge pages. Falls back to transparent huge pages if no hugetlb pages are
+// reserved. Returns NULL on failure.
+void *numa_alloc(size_t size, int node, int hugepages) {
+    void *buf = MAP_FAILED;
+    if (hugepages) {
+        buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buf == MAP_FAILED) {
+            static int warned;
+            if (!warned++) {
+                fprintf(stderr, "Warning: no hugetlb pages available, using transparent huge pages\n");
+            }
+        }
+    }
+    if (buf == MAP_FAILED) {
+        buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) return NULL;
+        if (hugepages) madvise(buf, size, MADV_HUGEPAGE);
+    }
+
+    if (node >= 0) {
+        unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+        mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        if (syscall(SYS_mbind, buf, size, MPOL_BIND, mask, MAX_NODES, MPOL_MF_MOVE) != 0) {
+            static int warned;
+            if (!warned++) {
+                fprintf(stderr, "Warning: mbind to node %d failed: %s\n", node, strerror(errno));
+            }
+        }
+    }
+    return buf;
+}
+
+void numa_free(void *buf, size_t size) {
+    munmap(buf, size);
+}
+
+// Fraction of sampled pages of buf that actually sit on node, or -1 if the
+// kernel cannot tell (move_pages not permitted or not supported).
+static double chase_on_node(void *buf, size_t size, int node) {
+    enum { SAMPLES = 64 };
+    void *pages[SAMPLES];
+    int status[SAMPLES];
+    size_t step = size / SAMPLES;
+    for (int i = 0; i < SAMPLES; i++) pages[i] = (char *)buf + i * step;
+    if (syscall(SYS_move_pages, 0, SAMPLES, pages, NULL, status, 0) != 0) return -1;
+    int hits = 0;
+    for (int i = 0; i < SAMPLES; i++) hits += status[i] == node;
+    return (double)hits / SAMPLES;
+}
+
+// Link the cache lines of buf into one random cycle (Sattolo's algorithm)
+void chase_build(void *buf, size_t size, unsigned seed) {
+    size_t lines = size / CACHE_LINE_SIZE;
+    uint32_t *perm = malloc(lines * sizeof(uint32_t));
+    if (!perm) { perror("malloc"); exit(1); }
+    for (size_t i = 0; i < lines; i++) perm[i] = i;
+    uint64_t x = seed * 0x9E3779B97F4A7C15ULL + 1;
+    for (size_t i = lines - 1; i > 0; i--) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;     // xorshift64
+        size_t j = x % i;                           // j < i: one single cycle
+        uint32_t t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+    }
+    char *base = buf;
+    for (size_t i = 0; i < lines; i++) {
+        *(void **)(base + i * CACHE_LINE_SIZE) = base + (size_t)perm[i] * CACHE_LINE_SIZE;
+    }
+    free(perm);
+}
+
+static void chase_job(pool_job_t *job, int role) {
+    chase_t *c = (chase_t *)job;
+    void **p = c->chain;
+    (void)role;
+
+    job_sync(job);
+    for (int i = 0; i < CHASE_WARMUP_CHUNKS * CHASE_CHUNK; i++) p = *p;
+    for (int i = 0; i < CHASE_CHUNKS; i++) {
+        uint64_t start = rdtsc_start();
+        for (int k = 0; k < CHASE_CHUNK; k++) p = *p;
+        hist_record(&c->res->hist, rdtsc_end() - start);
+    }
+    c->sink = p;
+}
+
+// Dependent-load latency of chain as seen from cpu; hist samples are
+// CHASE_CHUNK loads each. Returns -1 if cpu has no pinned worker.
+int chase_run(int cpu, void *chain, pair_result_t *res) {
+    chase_t c;
+    hist_init(&res->hist);
+    c.chain = chain;
+    c.res = res;
+    c.job.fn = chase_job;
+    c.job.nthreads = 1;
+    if (pool_dispatch(&c.job, &cpu) != 0) return -1;
+    pool_wait(&c.job);
+    return 0;
+}
+
+// Nodes that have memory, ascending. Without NUMA information this is the
+// single pseudo node -1 (no binding). Returns the count.
+int numa_mem_nodes(int *nodes, int max) {
+    unsigned char nodemask[MAX_NODES] = {0};
+    int count = 0;
+    char *list = read_line_file("/sys/devices/system/node/has_memory");
+    if (list && cpulist_parse(list, nodemask, MAX_NODES, NULL) > 0) {
+        for (int i = 0; i < MAX_NODES && count < max; i++) {
+            if (nodemask[i]) nodes[count++] = i;
+        }
+    } else {
+        fprintf(stderr, "Warning: no NUMA information, measuring unbound memory\n");
+        nodes[count++] = -1;
+    }
+    free(list);
+    return count;
+}
+
+void run_numa(const int *cpus, int n, size_t size, int hugepages, stat_t stat) {
+    int nodes[MAX_NODES];
+    int nnodes = numa_mem_nodes(nodes, MAX_NODES);
+
+    if (hugepages) size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    double scale = 1e9 / tsc_hz / CHASE_CHUNK;
+    pair_result_t *res = calloc((size_t)n * nnodes, sizeof(pair_result_t));
+    if (!res) { perror("calloc"); exit(1); }
+
+    printf("Pointer chase: %zu MB per node, %s pages, %d dependent loads per core and node\n",
+           size >> 20, hugepages ? "huge" : "base", CHASE_CHUNK * CHASE_CHUNKS);
+    for (int m = 0; m < nnodes; m++) {
+        void *buf = numa_alloc(size, nodes[m], hugepages);
+        if (!buf) { perror("mmap"); exit(1); }
+        chase_build(buf, size, m + 1);
+        if (nodes[m] >= 0) {
+            double frac = chase_on_node(buf, size, nodes[m]);
+            if (frac >= 0 && frac < 0.99) {
+                fprintf(stderr, "Warning: only %.0f%% of node %d's buffer is on node %d\n",
+                        frac * 100, nodes[m], nodes[m]);
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            chase_run(cpus[i], buf, &res[i * nnodes + m]);
+            fprintf(stderr, "\rNode %d: %d/%d cores", nodes[m], i + 1, n);
+        }
+        fprintf(stderr, "\n");
+        numa_free(buf, size);
+    }
+
+    printf("  cpu  node");
+    for (int m = 0; m < nnodes; m++) printf(" %7d", nodes[m]);
+    printf("\n");
+    lat_hist_t *local = malloc(2 * sizeof(lat_hist_t));
+    if (!local) { perror("malloc"); exit(1); }
+    hist_init(&local[0]);
+    hist_init(&local[1]);
+    for (int i = 0; i < n; i++) {
+        int home = topo_cpu(cpus[i])->node;
+        printf("%5d %5d", cpus[i], home);
+        for (int m = 0; m < nnodes; m++) {
+            const lat_hist_t *h = &res[i * nnodes + m].hist;
+            if (h->n == 0) {
+                printf("     n/a");
+                continue;
+            }
+            lat_stats_t st;
+            hist_stats(h, scale, &st);
+            printf(" %7.1f", stat_value(&st, stat));
+            hist_merge(&local[nodes[m] != home], h);
+        }
+        printf("\n");
+    }
+    printf("Matrix cells: %s ns per dependent load, row = core, column = memory node\n",
+           stat_name(stat));
+    if (nnodes > 1) {
+        for (int r = 0; r < 2; r++) {
+            if (local[r].n == 0) continue;
+            lat_stats_t st;
+            hist_stats(&local[r], scale, &st);
+            printf("  %-7s mean %7.1f ns  p99 %7.1f ns\n", r ? "remote" : "local", st.mean, st.p99);
+        }
+    }
+    free(local);
+    free(res);
+}
@@ -0,0 +1,343 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <time.h>
+
+// Structured matrix output (--json, --csv, --heatmap).
+// All latencies are one-way TSC cycles; tsc_hz converts them to time.
+// JSON keeps every pair's histogram (non-empty buckets only) so later runs
+// can compare distributions, not just summary statistics.
+
+#define HEAT_CELL 34            // heatmap cell size in pixels
+#define HEAT_LABEL 40
+
+// Value of the first "name : value" line of /proc/cpuinfo, malloc'd
+static char *cpuinfo_field(const char *name) {
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) return NULL;
+    char *line = NULL, *val = NULL;
+    size_t cap = 0, len = strlen(name);
+    while (!val && getline(&line, &cap, f) >= 0) {
+        if (strncmp(line, name, len) != 0 || !strchr(" \t:", line[len])) continue;
+        char *p = strchr(line, ':');
+        if (!p) continue;
+        p += 1 + strspn(p + 1, " \t");
+        p[strcspn(p, "\n")] = '\0';
+        val = strdup(p);
+    }
+    free(line);
+    fclose(f);
+    return val;
+}
+
+static char *cpu_governor(int cpu) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+    return read_line_file(path);
+}
+
+// Fingerprint of this host; the governor is the one of cpu
+void host_info(host_info_t *h, int cpu) {
+    if (gethostname(h->hostname, sizeof(h->hostname)) != 0) strcpy(h->hostname, "unknown");
+    h->hostname[sizeof(h->hostname) - 1] = '\0';
+    if (uname(&h->uts) != 0) memset(&h->uts, 0, sizeof(h->uts));
+    h->cpu_model = cpuinfo_field("model name");
+    h->microcode = cpuinfo_field("microcode");
+    h->governor = cpu_governor(cpu);
+}
+
+void host_free(host_info_t *h) {
+    free(h->cpu_model);
+    free(h->microcode);
+    free(h->governor);
+}
+
+static void json_str(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; s && *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+// Text for SVG/HTML: escape the markup characters
+static void xml_str(FILE *f, const char *s) {
+    for (; s && *s; s++) {
+        switch (*s) {
+            case '&': fputs("&amp;", f); break;
+            case '<': fputs("&lt;", f); break;
+            case '>': fputs("&gt;", f); break;
+            case '"': fputs("&quot;", f); break;
+            default: fputc(*s, f); break;
+        }
+    }
+}
+
+static FILE *output_open(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+    return f;
+}
+
+static int output_close(FILE *f, const char *path) {
+    int err = ferror(f);
+    if (fclose(f) != 0 || err) {
+        fprintf(stderr, "Error writing %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int pair_measured(const pair_result_t *r) {
+    return r->hist.n > 0;
+}
+
+static void json_stats(FILE *f, const lat_stats_t *st) {
+    fprintf(f, "\"mean\": %.2f, \"min\": %.2f, \"p50\": %.2f, \"p90\": %.2f, "
+            "\"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f",
+            st->mean, st->min, st->p50, st->p90, st->p99, st->p999, st->max);
+}
+
+static void json_perf(FILE *f, const char *role, const perf_counts_t *c) {
+    fprintf(f, "\"%s\": {\"ops\": %llu", role, (unsigned long long)c->ops);
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (!(c->valid & (1u << e))) continue;
+        fprintf(f, ", ");
+        json_str(f, perf_event_name(e));
+        fprintf(f, ": %llu", (unsigned long long)c->val[e]);
+    }
+    if (c->valid) fprintf(f, ", \"running\": %.3f", c->running);
+    fprintf(f, "}");
+}
+
+int write_json(const char *path, const matrix_out_t *m) {
+    FILE *f = output_open(path);
+    if (!f) return -1;
+    host_info_t h;
+    host_info(&h, m->cpus[0]);
+
+    char date[64];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(f, "{\n  \"tool\": \"c2c_latency\",\n  \"format\": 1,\n  \"date\": \"%s\",\n", date);
+    fprintf(f, "  \"command\": ");
+    char cmd[4096];
+    int len = 0;
+    for (int i = 0; i < m->argc && len < (int)sizeof(cmd); i++) {
+        len += snprintf(cmd + len, sizeof(cmd) - len, i ? " %s" : "%s", m->argv[i]);
+    }
+    json_str(f, m->argc ? cmd : "");
+
+    fprintf(f, ",\n  \"host\": {\n    \"hostname\": ");
+    json_str(f, h.hostname);
+    fprintf(f, ",\n    \"kernel\": ");
+    json_str(f, h.uts.release);
+    fprintf(f, ",\n    \"kernel_version\": ");
+    json_str(f, h.uts.version);
+    fprintf(f, ",\n    \"machine\": ");
+    json_str(f, h.uts.machine);
+    fprintf(f, ",\n    \"cpu_model\": ");
+    json_str(f, h.cpu_model);
+    fprintf(f, ",\n    \"microcode\": ");
+    json_str(f, h.microcode);
+    fprintf(f, ",\n    \"governor\": ");
+    json_str(f, h.governor);
+    fprintf(f, ",\n    \"tsc_hz\": %.0f,\n    \"tsc_invariant\": %d\n  },\n", tsc_hz, tsc_invariant());
+
+    fprintf(f, "  \"run\": {\"pattern\": ");
+    json_str(f, m->pattern);
+    fprintf(f, ", \"home_node\": %d, \"iterations\": %d, \"one_way_scale\": %.2f},\n",
+            m->home_node, ITERATIONS, m->one_way);
+
+    fprintf(f, "  \"cpus\": [\n");
+    for (int i = 0; i < m->n; i++) {
+        const cpu_topo_t *t = topo_cpu(m->cpus[i]);
+        char *gov = cpu_governor(m->cpus[i]);
+        fprintf(f, "    {\"cpu\": %d, \"node\": %d, \"package\": %d, \"die\": %d, "
+                "\"l3\": %d, \"core\": %d, \"governor\": ",
+                m->cpus[i], t->node, t->package, t->die, t->l3, t->core);
+        json_str(f, gov);
+        fprintf(f, "}%s\n", i + 1 < m->n ? "," : "");
+        free(gov);
+    }
+    fprintf(f, "  ],\n");
+
+    // Pairs: stats are one-way cycles, histograms are raw recorded samples
+    // (multiply bucket values by one_way_scale)
+    fprintf(f, "  \"pairs\": [");
+    int first = 1;
+    for (int i = 0; i < m->n; i++) {
+        for (int j = 0; j < m->n; j++) {
+            const pair_result_t *r = &m->res[i * m->n + j];
+            if (i == j || !pair_measured(r)) continue;
+            lat_stats_t st;
+            hist_stats(&r->hist, m->one_way, &st);
+            fprintf(f, "%s\n    {\"from\": %d, \"to\": %d, \"tier\": \"%s\", \"samples\": %llu, ",
+                    first ? "" : ",", m->cpus[i], m->cpus[j],
+                    tier_name(topo_tier(m->cpus[i], m->cpus[j])), (unsigned long long)r->hist.n);
+            first = 0;
+            json_stats(f, &st);
+
+            fprintf(f, ",\n     \"hist\": {\"n\": %llu, \"sum\": %.0f, \"min\": %llu, \"max\": %llu, "
+                    "\"buckets\": [", (unsigned long long)r->hist.n,
+                    r->hist.sum, (unsigned long long)r->hist.min,
+                    (unsigned long long)r->hist.max);
+            int any = 0;
+            for (int b = 0; b < HIST_BUCKETS; b++) {
+                if (!r->hist.counts[b]) continue;
+                fprintf(f, "%s[%d, %llu]", any++ ? ", " : "", b, (unsigned long long)r->hist.counts[b]);
+            }
+            fprintf(f, "]}");
+
+            if (r->mirrored) fprintf(f, ",\n     \"mirrored\": true");
+            if (r->bw_cycles) fprintf(f, ",\n     \"bw_gbps\": %.3f", bw_gbps(r));
+            if (r->perf[0].valid || r->perf[1].valid) {
+                fprintf(f, ",\n     \"perf\": {");
+                json_perf(f, "leader", &r->perf[0]);
+                fprintf(f, ", ");
+                json_perf(f, "follower", &r->perf[1]);
+                fprintf(f, "}");
+            }
+            if (m->noise) {
+                fprintf(f, ",\n     \"noise\": {\"irqs\": %llu, \"csw\": %u, \"reruns\": %d, "
+                        "\"noisy\": %s}", (unsigned long long)r->noise_irqs,
+                        r->noise_csw[0] + r->noise_csw[1], r->reruns,
+                        r->noisy ? "true" : "false");
+            }
+            fprintf(f, "}");
+        }
+    }
+    fprintf(f, "\n  ]\n}\n");
+    host_free(&h);
+    return output_close(f, path);
+}
+
+// One row per ordered pair; the host fingerprint goes into '#' comment
+// lines ahead of the header so the file still loads as plain CSV with a
+// comment character set.
+int write_csv(const char *path, const matrix_out_t *m) {
+    FILE *f = output_open(path);
+    if (!f) return -1;
+    host_info_t h;
+    host_info(&h, m->cpus[0]);
+    fprintf(f, "# hostname=%s\n# kernel=%s %s\n# cpu_model=%s\n# microcode=%s\n"
+            "# governor=%s\n# tsc_hz=%.0f\n# pattern=%s\n# home_node=%d\n",
+            h.hostname, h.uts.release, h.uts.version, h.cpu_model ? h.cpu_model : "",
+            h.microcode ? h.microcode : "", h.governor ? h.governor : "", tsc_hz,
+            m->pattern, m->home_node);
+    host_free(&h);
+
+    fprintf(f, "from,to,tier,from_node,to_node,from_core,to_core,samples,"
+            "mean,min,p50,p90,p99,p999,max,mean_ns,p50_ns,bw_gbps\n");
+    for (int i = 0; i < m->n; i++) {
+        for (int j = 0; j < m->n; j++) {
+            const pair_result_t *r = &m->res[i * m->n + j];
+            if (i == j || !pair_measured(r)) continue;
+            const cpu_topo_t *ta = topo_cpu(m->cpus[i]), *tb = topo_cpu(m->cpus[j]);
+            lat_stats_t st;
+            hist_stats(&r->hist, m->one_way, &st);
+            fprintf(f, "%d,%d,%s,%d,%d,%d,%d,%llu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f\n",
+                    m->cpus[i], m->cpus[j], tier_name(topo_tier(m->cpus[i], m->cpus[j])),
+                    ta->node, tb->node, ta->core, tb->core, (unsigned long long)r->hist.n,
+                    st.mean, st.min, st.p50, st.p90, st.p99, st.p999, st.max,
+                    st.mean * 1e9 / tsc_hz, st.p50 * 1e9 / tsc_hz, bw_gbps(r));
+        }
+    }
+    return output_close(f, path);
+}
+
+// Green (fast) -> yellow -> red (slow)
+static void heat_color(double x, char *buf, size_t len) {
+    if (x < 0) x = 0;
+    if (x > 1) x = 1;
+    int r = x < 0.5 ? (int)(510 * x) : 255;
+    int g = x < 0.5 ? 200 : (int)(200 * (1 - x) * 2);
+    snprintf(buf, len, "#%02x%02x40", r, g);
+}
+
+// SVG heatmap of the chosen statistic, or an HTML page around it when the
+// file name ends in .html
+int write_heatmap(const char *path, const matrix_out_t *m, stat_t stat, int unit_ns) {
+    FILE *f = output_open(path);
+    if (!f) return -1;
+    size_t plen = strlen(path);
+    int html = plen >= 5 && strcmp(path + plen - 5, ".html") == 0;
+    double scale = unit_ns ? m->one_way * 1e9 / tsc_hz : m->one_way;
+    const char *unit = unit_ns ? "ns" : "cycles";
+
+    int n = m->n;
+    double *val = malloc((size_t)n * n * sizeof(double));
+    if (!val) { perror("malloc"); fclose(f); return -1; }
+    double lo = 0, hi = 0;
+    int any = 0;
+    for (int k = 0; k < n * n; k++) {
+        val[k] = -1;
+        if (k / n == k % n || !pair_measured(&m->res[k])) continue;
+        lat_stats_t st;
+        hist_stats(&m->res[k].hist, scale, &st);
+        val[k] = stat_value(&st, stat);
+        if (!any++ || val[k] < lo) lo = val[k];
+        if (val[k] > hi) hi = val[k];
+    }
+
+    host_info_t h;
+    host_info(&h, m->cpus[0]);
+    if (html) {
+        fprintf(f, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>c2c_latency ");
+        xml_str(f, h.hostname);
+        fprintf(f, "</title></head>\n<body style=\"font-family:sans-serif\">\n"
+                "<h2>Core-to-core latency: ");
+        xml_str(f, h.hostname);
+        fprintf(f, "</h2>\n<p>");
+        xml_str(f, h.cpu_model ? h.cpu_model : "unknown CPU");
+        fprintf(f, ", kernel ");
+        xml_str(f, h.uts.release);
+        fprintf(f, ", microcode ");
+        xml_str(f, h.microcode ? h.microcode : "-");
+        fprintf(f, ", governor ");
+        xml_str(f, h.governor ? h.governor : "-");
+        fprintf(f, ", TSC %.3f GHz, pattern ", tsc_hz / 1e9);
+        xml_str(f, m->pattern);
+        fprintf(f, "</p>\n");
+    }
+    host_free(&h);
+
+    int size = HEAT_LABEL + n * HEAT_CELL;
+    fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+            "font-family=\"sans-serif\" font-size=\"10\">\n", size, size + 20);
+    fprintf(f, "<text x=\"0\" y=\"%d\">one-way %s latency (%s), row = from, column = to</text>\n",
+            size + 14, stat_name(stat), unit);
+    for (int i = 0; i < n; i++) {
+        int pos = HEAT_LABEL + i * HEAT_CELL + HEAT_CELL / 2;
+        fprintf(f, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\">%d</text>\n",
+                pos, HEAT_LABEL - 8, m->cpus[i]);
+        fprintf(f, "<text x=\"%d\" y=\"%d\" text-anchor=\"end\">%d</text>\n",
+                HEAT_LABEL - 6, pos + 4, m->cpus[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double v = val[i * n + j];
+            int x = HEAT_LABEL + j * HEAT_CELL, y = HEAT_LABEL + i * HEAT_CELL;
+            char color[16] = "#dddddd";
+            if (v >= 0) heat_color(hi > lo ? (v - lo) / (hi - lo) : 0, color, sizeof(color));
+            fprintf(f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"%s\" "
+                    "stroke=\"#ffffff\">", x, y, HEAT_CELL, HEAT_CELL, color);
+            if (v >= 0) {
+                fprintf(f, "<title>%d -&gt; %d (", m->cpus[i], m->cpus[j]);
+                xml_str(f, tier_name(topo_tier(m->cpus[i], m->cpus[j])));
+                fprintf(f, "): %.1f %s</title></rect>"
+                        "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\">%.0f</text>\n",
+                        v, unit, x + HEAT_CELL / 2, y + HEAT_CELL / 2 + 4, v);
+            } else {
+                fprintf(f, "</rect>\n");
+            }
+        }
+    }
+    fprintf(f, "</svg>\n");
+    if (html) fprintf(f, "</body></html>\n");
+    free(val);
+    return output_close(f, path);
+}
@@ -0,0 +1,164 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+
+// Hardware performance counters around the timed loop (--perf).
+// Each measured thread opens one counter group on itself, user space
+// only, enables it after the warm-up and reads it at the end. Events the
+// PMU does not offer (virtualized, missing, or no permission) are dropped
+// once at start-up with a warning; the rest keep working. The software
+// context-switch counter is always there and flags interference.
+// A group the kernel never scheduled (PMU busy or too many events) reads
+// as not counted; one that was multiplexed is scaled by enabled/running.
+
+int perf_enabled;
+uint64_t perf_raw_config;           // 0 = no raw event
+
+static int perf_available[PERF_NUM_EVENTS];
+
+static const char *perf_names[PERF_NUM_EVENTS] = {
+    "cycles", "instructions", "ref-cycles", "LLC misses", "ctx switches", "raw"
+};
+
+typedef struct {
+    int fd[PERF_NUM_EVENTS];        // -1 = not counted
+    int leader;
+} perf_group_t;
+
+static void perf_attr(int event, struct perf_event_attr *attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->disabled = 1;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                        PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (event) {
+        case PERF_CYCLES: attr->config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PERF_INSTRUCTIONS: attr->config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PERF_REF_CYCLES: attr->config = PERF_COUNT_HW_REF_CPU_CYCLES; break;
+        case PERF_LLC_MISSES: attr->config = PERF_COUNT_HW_CACHE_MISSES; break;
+        case PERF_CTX_SWITCHES:
+            attr->type = PERF_TYPE_SOFTWARE;
+            attr->config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+            attr->exclude_kernel = 0;   // switches happen in the kernel
+            break;
+        default:
+            attr->type = PERF_TYPE_RAW;
+            attr->config = perf_raw_config;
+            break;
+    }
+}
+
+static int perf_event_open(struct perf_event_attr *attr, int group_fd) {
+    return syscall(SYS_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+// Probe which events can be counted on this machine. Returns the number
+// of usable events; 0 leaves perf disabled.
+int perf_init(void) {
+    int count = 0;
+    char missing[256] = "";
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (e == PERF_RAW && !perf_raw_config) continue;
+        struct perf_event_attr attr;
+        perf_attr(e, &attr);
+        int fd = perf_event_open(&attr, -1);
+        if (fd >= 0) {
+            perf_available[e] = 1;
+            count++;
+            close(fd);
+        } else {
+            size_t len = strlen(missing);
+            snprintf(missing + len, sizeof(missing) - len, "%s%s", len ? ", " : "", perf_names[e]);
+        }
+    }
+    if (missing[0]) {
+        fprintf(stderr, "Warning: perf events not available (virtualized PMU or "
+                "perf_event_paranoid?): %s\n", missing);
+    }
+    perf_enabled = count > 0;
+    return count;
+}
+
+const char *perf_event_name(perf_event_t event) {
+    return perf_names[event];
+}
+
+int perf_event_available(perf_event_t event) {
+    return perf_enabled && perf_available[event];
+}
+
+static void perf_open(perf_group_t *g) {
+    g->leader = -1;
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        g->fd[e] = -1;
+        if (!perf_available[e]) continue;
+        struct perf_event_attr attr;
+        perf_attr(e, &attr);
+        g->fd[e] = perf_event_open(&attr, g->leader);
+        if (g->fd[e] >= 0 && g->leader < 0) g->leader = g->fd[e];
+    }
+}
+
+static void perf_close(perf_group_t *g) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (g->fd[e] >= 0) close(g->fd[e]);
+    }
+}
+
+// Thread-local group of the calling worker; opened by perf_begin()
+static __thread perf_group_t perf_group;
+
+// Open the calling thread's counters, still stopped
+void perf_begin(void) {
+    if (!perf_enabled) return;
+    perf_open(&perf_group);
+}
+
+// Start counting; call right before the measured loop
+void perf_start(void) {
+    if (!perf_enabled || perf_group.leader < 0) return;
+    ioctl(perf_group.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf_group.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Stop counting and store the counts of ops operations in out
+void perf_end(perf_counts_t *out, uint64_t ops) {
+    if (!perf_enabled) return;
+    perf_group_t *g = &perf_group;
+    memset(out, 0, sizeof(*out));
+    if (g->leader < 0) {
+        perf_close(g);
+        return;
+    }
+    ioctl(g->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // nr, time_enabled, time_running, then one value per member in open order
+    uint64_t buf[3 + PERF_NUM_EVENTS];
+    if (read(g->leader, buf, sizeof(buf)) > 0 && buf[2] > 0) {
+        double scale = buf[2] < buf[1] ? (double)buf[1] / buf[2] : 1.0;
+        int k = 0;
+        for (int e = 0; e < PERF_NUM_EVENTS && k < (int)buf[0]; e++) {
+            if (g->fd[e] < 0) continue;
+            out->val[e] = (uint64_t)(buf[3 + k++] * scale + 0.5);
+            out->valid |= 1u << e;
+        }
+        out->ops = ops;
+        out->running = 1.0 / scale;
+    }
+    perf_close(g);
+}
+
+// 1 if the counts were scaled because the group was multiplexed
+int perf_scaled(const perf_counts_t *c) {
+    return c->valid && c->running < 1.0;
+}
+
+// Count per operation, or -1 if the event was not counted
+double perf_per_op(const perf_counts_t *c, perf_event_t event) {
+    if (!(c->valid & (1u << event)) || c->ops == 0) return -1;
+    return (double)c->val[event] / c->ops;
+}
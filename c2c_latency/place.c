@@ -0,0 +1,319 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <math.h>
+
+// Thread placement (--place).
+// Assigns the stages of a communication graph to distinct CPUs so that the
+// sum over edges of weight * one-way latency (sender -> receiver) is as low
+// as possible. The graph file has one edge per line:
+//
+//     # sender receiver [weight]
+//     reader  parser  10
+//     parser  writer  4
+//     stage   monitor         (a stage without edges)
+//
+// A greedy start (heaviest stages first, each next to its placed
+// neighbours) is improved by simulated annealing over move/swap steps and
+// finished with a hill climb, so the result is at least a local optimum.
+// The random generator has a fixed seed: the same input gives the same
+// placement.
+
+#define PLACE_MAX_STAGES 1024
+#define PLACE_NAME_LEN 64
+#define PLACE_STEPS_PER_STAGE 20000
+#define PLACE_UNKNOWN 1e9       // ns charged for a pair missing from the matrix
+
+typedef struct {
+    int from, to;
+    double weight;
+} place_edge_t;
+
+typedef struct {
+    int nstages;
+    char (*names)[PLACE_NAME_LEN];
+    int nedges;
+    place_edge_t *edges;
+
+    const int *cpus;            // candidates
+    int ncpus;
+    const double *lat;          // ncpus x ncpus one-way ns, < 0 = unknown
+    int no_smt;
+} place_t;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double rng_unit(void) {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int stage_id(place_t *pl, const char *name) {
+    for (int s = 0; s < pl->nstages; s++) {
+        if (strcmp(pl->names[s], name) == 0) return s;
+    }
+    if (pl->nstages == PLACE_MAX_STAGES) return -1;
+    snprintf(pl->names[pl->nstages], PLACE_NAME_LEN, "%s", name);
+    return pl->nstages++;
+}
+
+static int read_graph(const char *path, place_t *pl) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Cannot read %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    pl->names = malloc(PLACE_MAX_STAGES * sizeof(*pl->names));
+    int cap = 64;
+    pl->edges = malloc(cap * sizeof(place_edge_t));
+    if (!pl->names || !pl->edges) { perror("malloc"); exit(1); }
+
+    char *line = NULL;
+    size_t len = 0;
+    int lineno = 0, ret = 0;
+    while (ret == 0 && getline(&line, &len, f) >= 0) {
+        lineno++;
+        line[strcspn(line, "#\n")] = '\0';
+        char *tok[4], *save, *end;
+        int fields = 0;
+        for (char *t = strtok_r(line, " \t", &save); t && fields < 4; t = strtok_r(NULL, " \t", &save)) {
+            tok[fields++] = t;
+        }
+        if (fields == 0) continue;
+        double w = fields >= 3 ? strtod(tok[2], &end) : 1;
+        if (fields == 4 || (fields == 3 && (end == tok[2] || *end)) || w < 0 ||
+            strlen(tok[0]) >= PLACE_NAME_LEN || (fields >= 2 && strlen(tok[1]) >= PLACE_NAME_LEN)) {
+            ret = -1;
+        }
+        int sa = ret ? -1 : stage_id(pl, tok[0]);
+        int sb = fields >= 2 && !ret ? stage_id(pl, tok[1]) : sa;
+        if (sa < 0 || sb < 0) ret = -1;
+        if (ret != 0) {
+            fprintf(stderr, "%s:%d: expected 'sender receiver [weight >= 0]'\n", path, lineno);
+            break;
+        }
+        if (fields == 1 || sa == sb) continue;
+        if (pl->nedges == cap) {
+            pl->edges = realloc(pl->edges, (cap *= 2) * sizeof(place_edge_t));
+            if (!pl->edges) { perror("realloc"); exit(1); }
+        }
+        pl->edges[pl->nedges++] = (place_edge_t){sa, sb, w};
+    }
+    free(line);
+    fclose(f);
+    if (ret == 0 && pl->nstages == 0) {
+        fprintf(stderr, "%s has no stages\n", path);
+        ret = -1;
+    }
+    return ret;
+}
+
+static double hop(const place_t *pl, int ca, int cb) {
+    double v = pl->lat[ca * pl->ncpus + cb];
+    return v >= 0 ? v : PLACE_UNKNOWN;
+}
+
+static double place_cost(const place_t *pl, const int *assign) {
+    double cost = 0;
+    for (int e = 0; e < pl->nedges; e++) {
+        const place_edge_t *ed = &pl->edges[e];
+        cost += ed->weight * hop(pl, assign[ed->from], assign[ed->to]);
+    }
+    return cost;
+}
+
+// May stage s sit on candidate c, given where the other stages are?
+static int place_ok(const place_t *pl, const int *assign, int s, int c, int skip) {
+    if (!pl->no_smt) return 1;
+    for (int t = 0; t < pl->nstages; t++) {
+        if (t == s || t == skip || assign[t] < 0) continue;
+        if (topo_tier(pl->cpus[c], pl->cpus[assign[t]]) == TIER_SMT) return 0;
+    }
+    return 1;
+}
+
+// Heaviest stages first, each on the free candidate cheapest to its placed
+// neighbours (the first one on the candidate closest to all others)
+static int place_greedy(const place_t *pl, int *assign, int *owner) {
+    int n = pl->nstages;
+    double *load = calloc(n, sizeof(double));
+    int *order = malloc(n * sizeof(int));
+    if (!load || !order) { perror("malloc"); exit(1); }
+    for (int e = 0; e < pl->nedges; e++) {
+        load[pl->edges[e].from] += pl->edges[e].weight;
+        load[pl->edges[e].to] += pl->edges[e].weight;
+    }
+    for (int s = 0; s < n; s++) {
+        int k = s;
+        while (k > 0 && load[order[k - 1]] < load[s]) { order[k] = order[k - 1]; k--; }
+        order[k] = s;
+    }
+    for (int s = 0; s < n; s++) assign[s] = -1;
+    for (int c = 0; c < pl->ncpus; c++) owner[c] = -1;
+
+    int ret = 0;
+    for (int k = 0; k < n && ret == 0; k++) {
+        int s = order[k], pick = -1;
+        double best = 0;
+        for (int c = 0; c < pl->ncpus; c++) {
+            if (owner[c] >= 0 || !place_ok(pl, assign, s, c, -1)) continue;
+            double cost = 0;
+            for (int e = 0; e < pl->nedges; e++) {
+                const place_edge_t *ed = &pl->edges[e];
+                if (ed->from == s && assign[ed->to] >= 0) cost += ed->weight * hop(pl, c, assign[ed->to]);
+                if (ed->to == s && assign[ed->from] >= 0) cost += ed->weight * hop(pl, assign[ed->from], c);
+            }
+            if (k == 0) {
+                for (int d = 0; d < pl->ncpus; d++) if (d != c) cost += hop(pl, c, d);
+            }
+            if (pick < 0 || cost < best) {
+                pick = c;
+                best = cost;
+            }
+        }
+        if (pick < 0) ret = -1;
+        else {
+            assign[s] = pick;
+            owner[pick] = s;
+        }
+    }
+    free(load);
+    free(order);
+    return ret;
+}
+
+// Try moving stage s to candidate c (swapping with its owner, if any).
+// Applies the step and returns 1 if it is allowed.
+static int place_step(const place_t *pl, int *assign, int *owner, int s, int c) {
+    int from = assign[s], t = owner[c];
+    if (c == from) return 0;
+    if (!place_ok(pl, assign, s, c, t)) return 0;
+    if (t >= 0) {
+        // s and t swap; their two CPUs were compatible before the swap
+        if (!place_ok(pl, assign, t, from, s)) return 0;
+        assign[t] = from;
+    }
+    owner[from] = t;
+    owner[c] = s;
+    assign[s] = c;
+    return 1;
+}
+
+static void place_undo(int *assign, int *owner, int s, int from, int c) {
+    int t = owner[from];
+    assign[s] = from;
+    owner[from] = s;
+    owner[c] = t;
+    if (t >= 0) assign[t] = c;
+}
+
+static void place_anneal(const place_t *pl, int *assign, int *owner) {
+    int n = pl->nstages;
+    int *best = malloc(n * sizeof(int));
+    if (!best) { perror("malloc"); exit(1); }
+    memcpy(best, assign, n * sizeof(int));
+    double cost = place_cost(pl, assign), best_cost = cost;
+    double t0 = pl->nedges ? cost / pl->nedges : 0, t_end = t0 * 1e-4;
+    long steps = (long)PLACE_STEPS_PER_STAGE * n;
+
+    for (long i = 0; i < steps && t0 > 0; i++) {
+        double temp = t0 * pow(t_end / t0, (double)i / steps);
+        int s = rng_next() % n, c = rng_next() % pl->ncpus, from = assign[s];
+        if (!place_step(pl, assign, owner, s, c)) continue;
+        double next = place_cost(pl, assign);
+        if (next <= cost || rng_unit() < exp((cost - next) / temp)) {
+            cost = next;
+            if (cost < best_cost) {
+                best_cost = cost;
+                memcpy(best, assign, n * sizeof(int));
+            }
+        } else {
+            place_undo(assign, owner, s, from, c);
+        }
+    }
+
+    // Restore the best state, then hill climb over every move and swap
+    memcpy(assign, best, n * sizeof(int));
+    for (int c = 0; c < pl->ncpus; c++) owner[c] = -1;
+    for (int s = 0; s < n; s++) owner[assign[s]] = s;
+    cost = place_cost(pl, assign);
+    for (int improved = 1; improved; ) {
+        improved = 0;
+        for (int s = 0; s < n; s++) {
+            for (int c = 0; c < pl->ncpus; c++) {
+                int from = assign[s];
+                if (!place_step(pl, assign, owner, s, c)) continue;
+                double next = place_cost(pl, assign);
+                if (next < cost - 1e-9) {
+                    cost = next;
+                    improved = 1;
+                } else {
+                    place_undo(assign, owner, s, from, c);
+                }
+            }
+        }
+    }
+    free(best);
+}
+
+// Place the stages of graph_path on cpus[0..n-1]; lat[i * n + j] is the
+// one-way ns from cpus[i] to cpus[j] (< 0 unknown). Returns 0 on success.
+int run_place(const char *graph_path, const int *cpus, int n, const double *lat, int no_smt) {
+    place_t pl = {0};
+    pl.cpus = cpus;
+    pl.ncpus = n;
+    pl.lat = lat;
+    pl.no_smt = no_smt;
+    if (read_graph(graph_path, &pl) != 0) return -1;
+    if (pl.nstages > n) {
+        fprintf(stderr, "%d stages do not fit on %d CPUs\n", pl.nstages, n);
+        return -1;
+    }
+
+    int *assign = malloc(pl.nstages * sizeof(int));
+    int *owner = malloc(n * sizeof(int));
+    if (!assign || !owner) { perror("malloc"); exit(1); }
+    int ret = place_greedy(&pl, assign, owner);
+    if (ret != 0) {
+        fprintf(stderr, "No placement of %d stages on %d CPUs%s\n", pl.nstages, n,
+                no_smt ? " without sharing a core" : "");
+    } else {
+        double greedy = place_cost(&pl, assign);
+        place_anneal(&pl, assign, owner);
+
+        printf("Placement of %d stages, %d edges on %d CPUs%s\n", pl.nstages, pl.nedges, n,
+               no_smt ? ", one stage per core" : "");
+        printf("  %-20s  CPU  Node  Core\n", "Stage");
+        for (int s = 0; s < pl.nstages; s++) {
+            const cpu_topo_t *t = topo_cpu(cpus[assign[s]]);
+            printf("  %-20s %4d %5d %5d\n", pl.names[s], cpus[assign[s]], t->node, t->core);
+        }
+        printf("Edges (one-way p50 ns):\n");
+        for (int e = 0; e < pl.nedges; e++) {
+            const place_edge_t *ed = &pl.edges[e];
+            int ca = assign[ed->from], cb = assign[ed->to];
+            printf("  %-20s -> %-20s %8.2f x %7.1f ns  (%s)\n", pl.names[ed->from],
+                   pl.names[ed->to], ed->weight, hop(&pl, ca, cb),
+                   tier_name(topo_tier(cpus[ca], cpus[cb])));
+        }
+        printf("Weighted latency: %.1f ns (greedy start %.1f ns)\n", place_cost(&pl, assign), greedy);
+
+        printf("\n");
+        for (int s = 0; s < pl.nstages; s++) {
+            printf("%s: taskset -c %d\n", pl.names[s], cpus[assign[s]]);
+        }
+        printf("cpulist: ");
+        for (int s = 0; s < pl.nstages; s++) printf("%s%d", s ? "," : "", cpus[assign[s]]);
+        printf("\n");
+    }
+    free(assign);
+    free(owner);
+    free(pl.names);
+    free(pl.edges);
+    return ret;
+}
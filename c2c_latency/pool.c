@@ -0,0 +1,146 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <limits.h>
+
+// Persistent pool of pinned workers, one per selected CPU.
+// Idle workers park in futex_wait() on their dispatch counter, so they cost
+// nothing while other pairs are measured. pool_dispatch() hands a job to
+// the workers of the given CPUs and wakes them; the job's threads line up
+// with job_sync() before timing and the dispatcher sleeps in pool_wait()
+// until all of them are done. A worker's last access to the job is its
+// increment of job->done; the wakeup goes through the pool-owned
+// done_gen, so the dispatcher may free the job as soon as pool_wait()
+// returns.
+typedef struct {
+    int cpu;
+    int pinned;
+    pthread_t thread;
+    volatile uint32_t seq;      // bumped by every dispatch (futex word)
+    pool_job_t *job;            // NULL + seq bump = exit
+    int role;
+} __attribute__((aligned(CACHE_LINE_SIZE))) worker_t;
+
+// Bumped whenever a job completes (futex word of every pool_wait())
+static volatile uint32_t done_gen;
+
+static worker_t *workers;
+static int num_workers;
+static worker_t **worker_by_cpu;
+static int max_cpu;
+
+static void *worker_main(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    uint32_t seen = 0;
+
+    __atomic_store_n(&w->pinned, pin_thread_to_core(w->cpu) == 0, __ATOMIC_RELEASE);
+    for (;;) {
+        uint32_t seq;
+        while ((seq = __atomic_load_n(&w->seq, __ATOMIC_ACQUIRE)) == seen) {
+            futex_wait(&w->seq, seen);
+        }
+        seen = seq;
+
+        pool_job_t *job = w->job;
+        if (!job) break;
+        uint32_t nthreads = job->nthreads;
+        job->fn(job, w->role);
+        if (__atomic_add_fetch(&job->done, 1, __ATOMIC_RELEASE) == nthreads) {
+            __atomic_add_fetch(&done_gen, 1, __ATOMIC_RELEASE);
+            futex_wake(&done_gen, INT_MAX);
+        }
+    }
+    return NULL;
+}
+
+// Start one pinned worker per CPU. Workers that cannot be pinned stay in
+// the pool but are refused by pool_dispatch().
+int pool_init(const int *cpus, int n) {
+    workers = aligned_alloc(CACHE_LINE_SIZE, n * sizeof(worker_t));
+    max_cpu = 0;
+    for (int i = 0; i < n; i++) {
+        if (cpus[i] > max_cpu) max_cpu = cpus[i];
+    }
+    worker_by_cpu = calloc(max_cpu + 1, sizeof(worker_t *));
+    if (!workers || !worker_by_cpu) { perror("malloc"); return -1; }
+    memset(workers, 0, n * sizeof(worker_t));
+
+    for (int i = 0; i < n; i++) {
+        worker_t *w = &workers[i];
+        w->cpu = cpus[i];
+        w->pinned = -1;
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            perror("pthread_create");
+            return -1;
+        }
+        num_workers++;
+        worker_by_cpu[cpus[i]] = w;
+    }
+
+    // Wait until every worker has tried to pin itself
+    for (int i = 0; i < n; i++) {
+        while (__atomic_load_n(&workers[i].pinned, __ATOMIC_ACQUIRE) < 0) {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+void pool_destroy(void) {
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].job = NULL;
+        __atomic_add_fetch(&workers[i].seq, 1, __ATOMIC_RELEASE);
+        futex_wake(&workers[i].seq, 1);
+    }
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    free(workers);
+    free(worker_by_cpu);
+    workers = NULL;
+    worker_by_cpu = NULL;
+    num_workers = 0;
+}
+
+static worker_t *pool_worker(int cpu) {
+    if (!worker_by_cpu || cpu < 0 || cpu > max_cpu) return NULL;
+    return worker_by_cpu[cpu];
+}
+
+// Run job on cpus[0..job->nthreads-1]; cpus[k] executes role k.
+// Returns -1 without starting anything if a CPU has no pinned worker.
+// The caller must not dispatch two jobs to one CPU at the same time.
+int pool_dispatch(pool_job_t *job, const int *cpus) {
+    for (int k = 0; k < job->nthreads; k++) {
+        worker_t *w = pool_worker(cpus[k]);
+        if (!w || !w->pinned) return -1;
+    }
+
+    job->ready = 0;
+    job->done = 0;
+    for (int k = 0; k < job->nthreads; k++) {
+        worker_t *w = pool_worker(cpus[k]);
+        w->job = job;
+        w->role = k;
+        __atomic_add_fetch(&w->seq, 1, __ATOMIC_RELEASE);
+        futex_wake(&w->seq, 1);
+    }
+    return 0;
+}
+
+// Jobs on other CPUs complete on the same done_gen, so a wakeup may be for
+// another dispatcher's job; re-check and sleep again.
+void pool_wait(pool_job_t *job) {
+    for (;;) {
+        uint32_t gen = __atomic_load_n(&done_gen, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&job->done, __ATOMIC_ACQUIRE) >= (uint32_t)job->nthreads) break;
+        futex_wait(&done_gen, gen);
+    }
+}
+
+// Ready handshake: returns once every thread of the job has arrived.
+void job_sync(pool_job_t *job) {
+    __atomic_add_fetch(&job->ready, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&job->ready, __ATOMIC_ACQUIRE) < (uint32_t)job->nthreads) {
+        cpu_relax();
+    }
+}
@@ -0,0 +1,155 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+
+// Single-producer/single-consumer ring between two cores.
+// The producer (role 0) writes ring_msg_size-byte messages into a ring of
+// ring_depth slots and publishes its tail; the consumer (role 1) reads each
+// message whole and publishes its head. With cached indices each side keeps
+// a private copy of the other side's index and only rereads the shared one
+// when the ring looks full (producer) or empty (consumer); the naive ring
+// reads it for every message. Indices are published every ring_batch
+// messages. The first 8 bytes of a message carry the producer's TSC, so the
+// consumer gets the per-message latency including any queueing.
+
+#define RING_WARMUP 1024
+#define RING_MESSAGES (ITERATIONS * 5)
+
+size_t ring_msg_size = 64;
+int ring_depth = 256;
+int ring_batch = 1;
+int ring_naive;
+
+typedef struct {
+    volatile uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE)));   // producer
+    volatile uint64_t head __attribute__((aligned(CACHE_LINE_SIZE)));   // consumer
+    volatile uint64_t sink __attribute__((aligned(CACHE_LINE_SIZE)));
+} ring_ctrl_t;
+
+typedef struct {
+    pool_job_t job;
+    ring_ctrl_t *ctrl;
+    uint64_t *slots;
+    pair_result_t *res;
+} ring_t;
+
+static void ring_producer(ring_t *r) {
+    ring_ctrl_t *ctrl = r->ctrl;
+    size_t words = ring_msg_size / sizeof(uint64_t);
+    uint64_t mask = ring_depth - 1;
+    uint64_t total = RING_WARMUP + RING_MESSAGES;
+    uint64_t head = 0;
+
+    for (uint64_t tail = 0; tail < total; ) {
+        if (ring_naive || tail - head >= (uint64_t)ring_depth) {
+            while (tail - (head = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE)) >=
+                   (uint64_t)ring_depth) {
+                cpu_relax();
+            }
+        }
+        uint64_t *msg = &r->slots[(tail & mask) * words];
+        msg[0] = rdtsc();
+        for (size_t w = 1; w < words; w++) msg[w] = tail;
+        tail++;
+        if (tail % ring_batch == 0 || tail == total) {
+            __atomic_store_n(&ctrl->tail, tail, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void ring_consumer(ring_t *r) {
+    ring_ctrl_t *ctrl = r->ctrl;
+    size_t words = ring_msg_size / sizeof(uint64_t);
+    uint64_t mask = ring_depth - 1;
+    uint64_t total = RING_WARMUP + RING_MESSAGES;
+    uint64_t tail = 0, sum = 0, start = 0;
+    lat_hist_t *hist = &r->res->hist;
+
+    for (uint64_t head = 0; head < total; ) {
+        if (ring_naive || head == tail) {
+            while ((tail = __atomic_load_n(&ctrl->tail, __ATOMIC_ACQUIRE)) == head) {
+                cpu_relax();
+            }
+        }
+        const uint64_t *msg = &r->slots[(head & mask) * words];
+        uint64_t stamp = msg[0];
+        for (size_t w = 1; w < words; w++) sum += msg[w];
+        uint64_t now = rdtsc();
+        if (head == RING_WARMUP) start = now;
+        if (head >= RING_WARMUP) hist_record(hist, now - stamp);
+        head++;
+        if (head % ring_batch == 0 || head == total) {
+            __atomic_store_n(&ctrl->head, head, __ATOMIC_RELEASE);
+        }
+    }
+    r->res->ring_cycles = rdtsc_end() - start;
+    r->res->ring_msgs = RING_MESSAGES;
+    ctrl->sink = sum;   // keep the reads
+}
+
+static void ring_job(pool_job_t *job, int role) {
+    ring_t *r = (ring_t *)job;
+    if (role == 0) {
+        // First touch from the producer, like a ring owned by the sender
+        memset(r->slots, 0, ring_depth * ring_msg_size);
+    }
+    job_sync(job);
+    if (role == 0) ring_producer(r);
+    else ring_consumer(r);
+}
+
+static int ring_start(ring_t *r, int producer, int consumer, pair_result_t *res) {
+    r->ctrl = aligned_alloc(CACHE_LINE_SIZE, sizeof(ring_ctrl_t));
+    r->slots = aligned_alloc(CACHE_LINE_SIZE, ring_depth * ring_msg_size);
+    if (!r->ctrl || !r->slots) { perror("malloc"); exit(1); }
+    memset(r->ctrl, 0, sizeof(ring_ctrl_t));
+    hist_init(&res->hist);
+    r->res = res;
+    r->job.fn = ring_job;
+    r->job.nthreads = 2;
+    int cpus[2] = {producer, consumer};
+    if (pool_dispatch(&r->job, cpus) != 0) {
+        free(r->ctrl);
+        free(r->slots);
+        r->ctrl = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void ring_finish(ring_t *r) {
+    if (!r->ctrl) return;
+    pool_wait(&r->job);
+    free(r->ctrl);
+    free(r->slots);
+    r->ctrl = NULL;
+}
+
+int run_ring(int producer, int consumer, pair_result_t *res) {
+    ring_t r;
+    if (ring_start(&r, producer, consumer, res) != 0) return -1;
+    ring_finish(&r);
+    return 0;
+}
+
+// Batch runner for run_matrix_parallel()
+void ring_pair_batch(pair_job_t *jobs, int count, void *arg) {
+    (void)arg;
+    ring_t *r = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(ring_t));
+    if (!r) { perror("malloc"); exit(1); }
+    for (int dir = 0; dir < 2; dir++) {
+        for (int k = 0; k < count; k++) {
+            if (dir == 0) ring_start(&r[k], jobs[k].a, jobs[k].b, jobs[k].res_ab);
+            else if (jobs[k].res_ba) ring_start(&r[k], jobs[k].b, jobs[k].a, jobs[k].res_ba);
+            else r[k].ctrl = NULL;
+        }
+        for (int k = 0; k < count; k++) {
+            ring_finish(&r[k]);
+        }
+    }
+    free(r);
+}
+
+double ring_msgs_per_sec(const pair_result_t *res) {
+    if (res->ring_cycles == 0) return 0;
+    return res->ring_msgs / (res->ring_cycles / tsc_hz);
+}
@@ -0,0 +1,274 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <immintrin.h>
+
+// STREAM-style memory bandwidth (copy, scale, add, triad) per
+// (CPU node, memory node). The three arrays are bound to the memory node,
+// the threads run on CPUs of the CPU node, one per physical core first.
+// Kernels exist in scalar, AVX2 and AVX-512 flavours, each optionally with
+// non-temporal stores; the widest one the CPU supports is picked at run
+// time, so the binary needs no -m flags. Like STREAM, each kernel is run
+// STREAM_REPS times and the best time counts.
+
+#define STREAM_REPS 5
+#define STREAM_Q 3.0         // the scalar q of scale and triad
+
+static const char *kernel_names[NUM_STREAM_KERNELS] = {"scalar", "avx2", "avx512"};
+static const char *op_names[NUM_STREAM_OPS] = {"Copy", "Scale", "Add", "Triad"};
+static const int op_arrays[NUM_STREAM_OPS] = {2, 2, 3, 3};     // arrays touched
+
+typedef void (*stream_fn_t)(int op, double *a, double *b, double *c, size_t n, int nt);
+
+typedef struct {
+    volatile uint32_t count __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint32_t gen __attribute__((aligned(CACHE_LINE_SIZE)));
+} barrier_t;
+
+typedef struct {
+    pool_job_t job;
+    stream_fn_t fn;
+    int nt;
+    double *a, *b, *c;
+    size_t n;
+    barrier_t barrier;
+    uint64_t best[NUM_STREAM_OPS];      // cycles, written by role 0
+} stream_t;
+
+int stream_kernel_parse(const char *name) {
+    if (strcmp(name, "auto") == 0) return stream_kernel_best();
+    for (int i = 0; i < NUM_STREAM_KERNELS; i++) {
+        if (strcmp(name, kernel_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int stream_kernel_best(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return STREAM_AVX512;
+    if (__builtin_cpu_supports("avx2")) return STREAM_AVX2;
+    return STREAM_SCALAR;
+}
+
+int stream_kernel_supported(stream_kernel_t k) {
+    return (int)k <= stream_kernel_best();
+}
+
+// STREAM's four kernels: copy c = a, scale b = s*c, add c = a+b,
+// triad a = b + s*c. Vector loops need 64-byte aligned slices.
+static void stream_scalar(int op, double *a, double *b, double *c, size_t n, int nt) {
+    size_t i = 0;
+    if (nt) {
+        // SSE2 is baseline on x86-64, so the scalar flavour streams 16 bytes
+        __m128d s = _mm_set1_pd(STREAM_Q);
+        for (; i + 2 <= n; i += 2) {
+            switch (op) {
+                case STREAM_COPY: _mm_stream_pd(&c[i], _mm_load_pd(&a[i])); break;
+                case STREAM_SCALE: _mm_stream_pd(&b[i], _mm_mul_pd(s, _mm_load_pd(&c[i]))); break;
+                case STREAM_ADD:
+                    _mm_stream_pd(&c[i], _mm_add_pd(_mm_load_pd(&a[i]), _mm_load_pd(&b[i])));
+                    break;
+                default:
+                    _mm_stream_pd(&a[i], _mm_add_pd(_mm_load_pd(&b[i]),
+                                                    _mm_mul_pd(s, _mm_load_pd(&c[i]))));
+                    break;
+            }
+        }
+        _mm_sfence();
+    }
+    switch (op) {
+        case STREAM_COPY: for (; i < n; i++) c[i] = a[i]; break;
+        case STREAM_SCALE: for (; i < n; i++) b[i] = STREAM_Q * c[i]; break;
+        case STREAM_ADD: for (; i < n; i++) c[i] = a[i] + b[i]; break;
+        default: for (; i < n; i++) a[i] = b[i] + STREAM_Q * c[i]; break;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void store256(double *p, __m256d v, int nt) {
+    if (nt) _mm256_stream_pd(p, v);
+    else _mm256_store_pd(p, v);
+}
+
+__attribute__((target("avx2")))
+static void stream_avx2(int op, double *a, double *b, double *c, size_t n, int nt) {
+    __m256d s = _mm256_set1_pd(STREAM_Q);
+    size_t i = 0;
+    switch (op) {
+        case STREAM_COPY:
+            for (; i + 4 <= n; i += 4) store256(&c[i], _mm256_load_pd(&a[i]), nt);
+            break;
+        case STREAM_SCALE:
+            for (; i + 4 <= n; i += 4) store256(&b[i], _mm256_mul_pd(s, _mm256_load_pd(&c[i])), nt);
+            break;
+        case STREAM_ADD:
+            for (; i + 4 <= n; i += 4) {
+                store256(&c[i], _mm256_add_pd(_mm256_load_pd(&a[i]), _mm256_load_pd(&b[i])), nt);
+            }
+            break;
+        default:
+            for (; i + 4 <= n; i += 4) {
+                store256(&a[i], _mm256_add_pd(_mm256_load_pd(&b[i]),
+                                              _mm256_mul_pd(s, _mm256_load_pd(&c[i]))), nt);
+            }
+            break;
+    }
+    if (nt) _mm_sfence();
+    stream_scalar(op, a + i, b + i, c + i, n - i, 0);
+}
+
+__attribute__((target("avx512f")))
+static inline void store512(double *p, __m512d v, int nt) {
+    if (nt) _mm512_stream_pd(p, v);
+    else _mm512_store_pd(p, v);
+}
+
+__attribute__((target("avx512f")))
+static void stream_avx512(int op, double *a, double *b, double *c, size_t n, int nt) {
+    __m512d s = _mm512_set1_pd(STREAM_Q);
+    size_t i = 0;
+    switch (op) {
+        case STREAM_COPY:
+            for (; i + 8 <= n; i += 8) store512(&c[i], _mm512_load_pd(&a[i]), nt);
+            break;
+        case STREAM_SCALE:
+            for (; i + 8 <= n; i += 8) store512(&b[i], _mm512_mul_pd(s, _mm512_load_pd(&c[i])), nt);
+            break;
+        case STREAM_ADD:
+            for (; i + 8 <= n; i += 8) {
+                store512(&c[i], _mm512_add_pd(_mm512_load_pd(&a[i]), _mm512_load_pd(&b[i])), nt);
+            }
+            break;
+        default:
+            for (; i + 8 <= n; i += 8) {
+                store512(&a[i], _mm512_add_pd(_mm512_load_pd(&b[i]),
+                                              _mm512_mul_pd(s, _mm512_load_pd(&c[i]))), nt);
+            }
+            break;
+    }
+    if (nt) _mm_sfence();
+    stream_scalar(op, a + i, b + i, c + i, n - i, 0);
+}
+
+static const stream_fn_t kernels[NUM_STREAM_KERNELS] = {
+    stream_scalar, stream_avx2, stream_avx512
+};
+
+static void barrier_wait(barrier_t *b, int n) {
+    uint32_t gen = __atomic_load_n(&b->gen, __ATOMIC_ACQUIRE);
+    if (__atomic_add_fetch(&b->count, 1, __ATOMIC_ACQ_REL) == (uint32_t)n) {
+        b->count = 0;
+        __atomic_store_n(&b->gen, gen + 1, __ATOMIC_RELEASE);
+    } else {
+        while (__atomic_load_n(&b->gen, __ATOMIC_ACQUIRE) == gen) cpu_relax();
+    }
+}
+
+static void stream_job(pool_job_t *job, int role) {
+    stream_t *st = (stream_t *)job;
+    int nthreads = job->nthreads;
+    // Slices are whole cache lines so every vector access stays aligned
+    size_t per = (st->n / nthreads) & ~(size_t)7;
+    size_t lo = role * per;
+    size_t len = role == nthreads - 1 ? st->n - lo : per;
+
+    job_sync(job);
+    for (int r = 0; r < STREAM_REPS; r++) {
+        for (int op = 0; op < NUM_STREAM_OPS; op++) {
+            barrier_wait(&st->barrier, nthreads);
+            uint64_t start = rdtsc_start();
+            st->fn(op, st->a + lo, st->b + lo, st->c + lo, len, st->nt);
+            barrier_wait(&st->barrier, nthreads);
+            uint64_t cycles = rdtsc_end() - start;
+            if (role == 0 && (r == 0 || cycles < st->best[op])) st->best[op] = cycles;
+        }
+    }
+}
+
+// CPUs of cpus[] on node (topology order), one per physical core first,
+// then their SMT siblings. Returns the count written to out.
+static int node_cpus(const int *cpus, int n, int node, int *out) {
+    int count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < n; i++) {
+            const cpu_topo_t *t = topo_cpu(cpus[i]);
+            if (t->node != node) continue;
+            int first = 1;
+            for (int k = 0; k < i; k++) {
+                const cpu_topo_t *o = topo_cpu(cpus[k]);
+                if (o->node == node && o->package == t->package && o->core == t->core &&
+                    t->core >= 0) {
+                    first = 0;
+                    break;
+                }
+            }
+            if (first == (pass == 0)) out[count++] = cpus[i];
+        }
+    }
+    return count;
+}
+
+void run_stream(const int *cpus, int n, size_t size, stream_kernel_t kernel, int nt,
+                int nthreads, const int *mem_nodes, int nmem, int hugepages) {
+    int *node_list = malloc(n * sizeof(int));
+    int *group = malloc(n * sizeof(int));
+    if (!node_list || !group) { perror("malloc"); exit(1); }
+
+    // CPU nodes in topology order
+    int ncpu_nodes = 0;
+    for (int i = 0; i < n; i++) {
+        int node = topo_cpu(cpus[i])->node;
+        int seen = 0;
+        for (int k = 0; k < ncpu_nodes; k++) seen |= node_list[k] == node;
+        if (!seen) node_list[ncpu_nodes++] = node;
+    }
+
+    size_t elems = size / sizeof(double);
+    stream_t *st = aligned_alloc(CACHE_LINE_SIZE, sizeof(stream_t));
+    if (!st) { perror("malloc"); exit(1); }
+    printf("STREAM: %s kernels%s, %zu MB per array, best of %d\n", kernel_names[kernel],
+           nt ? " with non-temporal stores" : "", size >> 20, STREAM_REPS);
+    printf("CPU node  Mem node  Threads ");
+    for (int op = 0; op < NUM_STREAM_OPS; op++) printf(" %8s", op_names[op]);
+    printf("   (GB/s)\n");
+
+    for (int m = 0; m < nmem; m++) {
+        double *arr[3];
+        for (int k = 0; k < 3; k++) {
+            arr[k] = numa_alloc(size, mem_nodes[m], hugepages);
+            if (!arr[k]) { perror("mmap"); exit(1); }
+            for (size_t i = 0; i < elems; i++) arr[k][i] = k + 1.0;
+        }
+
+        for (int c = 0; c < ncpu_nodes; c++) {
+            int count = node_cpus(cpus, n, node_list[c], group);
+            if (nthreads > 0 && nthreads < count) count = nthreads;
+
+            memset(st, 0, sizeof(*st));
+            st->fn = kernels[kernel];
+            st->nt = nt;
+            st->a = arr[0];
+            st->b = arr[1];
+            st->c = arr[2];
+            st->n = elems;
+            st->job.fn = stream_job;
+            st->job.nthreads = count;
+            if (pool_dispatch(&st->job, group) != 0) {
+                fprintf(stderr, "Could not pin to the CPUs of node %d\n", node_list[c]);
+                continue;
+            }
+            pool_wait(&st->job);
+
+            printf("%8d  %8d  %7d ", node_list[c], mem_nodes[m], count);
+            for (int op = 0; op < NUM_STREAM_OPS; op++) {
+                double bytes = (double)op_arrays[op] * elems * sizeof(double);
+                printf(" %8.1f", bytes / (st->best[op] / tsc_hz) / 1e9);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+        for (int k = 0; k < 3; k++) numa_free(arr[k], size);
+    }
+    free(st);
+    free(group);
+    free(node_list);
+}
@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <math.h>
+
+// Token ring (--token-ring).
+// Thread k waits for the token in its own slot and passes it on by writing
+// the next thread's slot, so every hop is one cache line transfer from one
+// core to the next, like a stage of a pipeline handing over work. Thread 0
+// starts each rotation and times it until the token comes back.
+//
+// With a pairwise latency matrix the ring order can also be optimized: the
+// cost of an order is the sum of its one-way hop latencies, which is a
+// travelling salesman tour. Nearest neighbour from every start plus 2-opt
+// gets close enough for the core counts of one machine, and every
+// candidate is measured, not just predicted.
+
+#define TR_ROTATIONS (ITERATIONS / 10 > 100 ? ITERATIONS / 10 : 100)
+#define TR_WARMUP 100
+
+typedef struct {
+    volatile uint64_t seq __attribute__((aligned(CACHE_LINE_SIZE)));
+} tr_slot_t;
+
+typedef struct {
+    pool_job_t job;
+    tr_slot_t *slots;           // slots[k]: written by thread k-1, read by k
+    lat_hist_t *hist;           // rotation cycles, thread 0 only
+} token_ring_t;
+
+static void token_ring_job(pool_job_t *job, int role) {
+    token_ring_t *tr = (token_ring_t *)job;
+    int n = job->nthreads;
+    volatile uint64_t *mine = &tr->slots[role].seq;
+    volatile uint64_t *next = &tr->slots[(role + 1) % n].seq;
+
+    job_sync(job);
+    if (role == 0) {
+        for (uint64_t r = 1; r <= TR_WARMUP + TR_ROTATIONS; r++) {
+            uint64_t start = rdtsc_start();
+            *next = r;
+            while (*mine != r) cpu_relax();
+            uint64_t end = rdtsc_end();
+            if (r > TR_WARMUP) hist_record(tr->hist, end - start);
+        }
+    } else {
+        for (uint64_t r = 1; r <= TR_WARMUP + TR_ROTATIONS; r++) {
+            while (*mine != r) cpu_relax();
+            *next = r;
+        }
+    }
+}
+
+// Pass the token around order[0] -> order[1] -> ... -> order[0].
+// Returns -1 if a CPU has no pinned worker.
+static int token_ring_measure(const int *order, int n, lat_hist_t *hist) {
+    token_ring_t *tr = aligned_alloc(CACHE_LINE_SIZE, sizeof(token_ring_t));
+    tr_slot_t *slots = aligned_alloc(CACHE_LINE_SIZE, n * sizeof(tr_slot_t));
+    if (!tr || !slots) { perror("malloc"); exit(1); }
+    memset(slots, 0, n * sizeof(tr_slot_t));
+    hist_init(hist);
+    tr->slots = slots;
+    tr->hist = hist;
+    tr->job.fn = token_ring_job;
+    tr->job.nthreads = n;
+
+    int ret = pool_dispatch(&tr->job, order);
+    if (ret == 0) pool_wait(&tr->job);
+    free(slots);
+    free(tr);
+    return ret;
+}
+
+// Sum of hop latencies of the ring perm[0] -> ... -> perm[n-1] -> perm[0];
+// lat[i * n + j] is the one-way latency from index i to index j
+static double ring_cost(const double *lat, int n, const int *perm) {
+    double cost = 0;
+    for (int k = 0; k < n; k++) cost += lat[perm[k] * n + perm[(k + 1) % n]];
+    return cost;
+}
+
+// Greedy tour from every start, keep the cheapest
+static void ring_nearest(const double *lat, int n, int *perm) {
+    int *tour = malloc(n * sizeof(int));
+    unsigned char *seen = malloc(n);
+    if (!tour || !seen) { perror("malloc"); exit(1); }
+    double best = -1;
+
+    for (int start = 0; start < n; start++) {
+        memset(seen, 0, n);
+        tour[0] = start;
+        seen[start] = 1;
+        for (int k = 1; k < n; k++) {
+            int from = tour[k - 1], pick = -1;
+            for (int j = 0; j < n; j++) {
+                if (!seen[j] && (pick < 0 || lat[from * n + j] < lat[from * n + pick])) pick = j;
+            }
+            tour[k] = pick;
+            seen[pick] = 1;
+        }
+        double cost = ring_cost(lat, n, tour);
+        if (best < 0 || cost < best) {
+            best = cost;
+            memcpy(perm, tour, n * sizeof(int));
+        }
+    }
+    free(tour);
+    free(seen);
+}
+
+static void reverse(int *perm, int i, int j) {
+    for (; i < j; i++, j--) {
+        int t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+}
+
+// Costs within this relative margin are equal: on a mirrored (symmetric)
+// matrix a reversed ring sums the same hops in another order
+#define RING_EPS 1e-9
+
+// 2-opt: reverse segments while that makes the ring cheaper. The matrix
+// need not be symmetric, so every move is priced on the whole ring.
+static void ring_two_opt(const double *lat, int n, int *perm) {
+    double cost = ring_cost(lat, n, perm);
+    for (int improved = 1; improved; ) {
+        improved = 0;
+        for (int i = 1; i < n - 1; i++) {
+            for (int j = i + 1; j < n; j++) {
+                reverse(perm, i, j);
+                double c = ring_cost(lat, n, perm);
+                if (c < cost * (1 - RING_EPS)) {
+                    cost = c;
+                    improved = 1;
+                } else {
+                    reverse(perm, i, j);
+                }
+            }
+        }
+    }
+}
+
+// Rotate a ring so it starts at index 0, and turn it so perm[1] < perm[n-1]
+// if running it backwards costs the same: same ring, comparable with memcmp
+static void ring_normalize(const double *lat, int n, int *perm) {
+    int k = 0;
+    while (perm[k] != 0) k++;
+    reverse(perm, 0, k - 1);
+    reverse(perm, k, n - 1);
+    reverse(perm, 0, n - 1);
+    if (n < 3 || perm[1] < perm[n - 1]) return;
+    double cost = ring_cost(lat, n, perm);
+    reverse(perm, 1, n - 1);
+    if (fabs(ring_cost(lat, n, perm) - cost) > cost * RING_EPS) reverse(perm, 1, n - 1);
+}
+
+static void print_order(const int *cpus, const int *perm, int n) {
+    char buf[48];
+    int len = 0;
+    for (int k = 0; k < n && len < (int)sizeof(buf) - 12; k++) {
+        len += snprintf(buf + len, sizeof(buf) - len, k ? ",%d" : "%d", cpus[perm[k]]);
+    }
+    if (n > 0 && len >= (int)sizeof(buf) - 12) snprintf(buf + len, sizeof(buf) - len, ",...");
+    printf("  %-44s", buf);
+}
+
+// Measure the ring over cpus[0..n-1] in the given order and, if lat (one-way
+// cycles between cpus[i] and cpus[j]) is given, the optimized orders too.
+// label names the given order.
+void run_token_ring(const int *cpus, int n, const char *label, const double *lat,
+                    int unit_ns) {
+    double scale = unit_ns ? 1e9 / tsc_hz : 1.0;
+    const char *names[3] = {label, "nearest neighbour", "nearest neighbour + 2-opt"};
+    int ncand = lat ? 3 : 1;
+    int *perm = malloc((size_t)ncand * n * sizeof(int));
+    int *order = malloc(n * sizeof(int));
+    lat_hist_t *hist = malloc(sizeof(lat_hist_t));
+    if (!perm || !order || !hist) { perror("malloc"); exit(1); }
+
+    for (int k = 0; k < n; k++) perm[k] = k;
+    if (lat) {
+        ring_nearest(lat, n, &perm[n]);
+        memcpy(&perm[2 * n], &perm[n], n * sizeof(int));
+        ring_two_opt(lat, n, &perm[2 * n]);
+        ring_normalize(lat, n, &perm[n]);
+        ring_normalize(lat, n, &perm[2 * n]);
+    }
+
+    printf("Token ring over %d CPUs, %d rotations (%s)\n", n, TR_ROTATIONS,
+           unit_ns ? "ns" : "cycles");
+    printf("  %-26s  %-44s %9s %9s %9s %9s %9s\n", "Order", "", "predicted", "mean", "p50", "p99",
+           "per hop");
+    int best = -1;
+    double best_p50 = 0;
+    for (int c = 0; c < ncand; c++) {
+        int *p = &perm[c * n];
+        int same = -1;
+        for (int prev = 0; prev < c && same < 0; prev++) {
+            if (memcmp(&perm[prev * n], p, n * sizeof(int)) == 0) same = prev;
+        }
+        if (same >= 0) {
+            printf("  %-26s(same ring as %s)\n", names[c], names[same]);
+            continue;
+        }
+        for (int k = 0; k < n; k++) order[k] = cpus[p[k]];
+        if (token_ring_measure(order, n, hist) != 0) {
+            fprintf(stderr, "Could not pin the ring threads\n");
+            break;
+        }
+        lat_stats_t st;
+        hist_stats(hist, scale, &st);
+        printf("  %-26s", names[c]);
+        print_order(cpus, p, n);
+        if (lat) printf(" %9.0f", ring_cost(lat, n, p) * scale);
+        else printf(" %9s", "-");
+        printf(" %9.1f %9.1f %9.1f %9.1f\n", st.mean, st.p50, st.p99, st.p50 / n);
+        fflush(stdout);
+        if (best < 0 || st.p50 < best_p50) {
+            best = c;
+            best_p50 = st.p50;
+        }
+    }
+
+    if (lat && best >= 0) {
+        printf("Best ring (%s):", names[best]);
+        for (int k = 0; k < n; k++) printf("%s%d", k ? "," : " ", cpus[perm[best * n + k]]);
+        printf("\n");
+    }
+    free(hist);
+    free(order);
+    free(perm);
+}
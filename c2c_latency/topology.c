@@ -0,0 +1,328 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <dirent.h>
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#define SYSFS_NODE "/sys/devices/system/node"
+
+static cpu_topo_t *topo;
+static int topo_ncpus;
+
+static const char *tier_names[NUM_TIERS] = {
+    "SMT sibling", "same L3", "cross-L3 same socket", "cross-socket"
+};
+
+// Read a single integer from a sysfs file. Returns 0 on success.
+int read_int_file(const char *path, int *val) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int ret = (fscanf(f, "%d", val) == 1) ? 0 : -1;
+    fclose(f);
+    return ret;
+}
+
+// Read the first line of a file without the trailing newline.
+// Returns a malloc'd string or NULL.
+char *read_line_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
+    char *line = NULL;
+    size_t cap = 0;
+    if (getline(&line, &cap, f) < 0) {
+        free(line);
+        line = NULL;
+    } else {
+        line[strcspn(line, "\n")] = '\0';
+    }
+    fclose(f);
+    return line;
+}
+
+// Parse a kernel cpulist ("0-3,8,10-11") and set mask[cpu] for every CPU
+// in it. Ids >= max cannot exist here and are ignored; for a user-given list
+// pass what ("CPU", "node") to report them. Returns the number of ids set,
+// or -1 on a malformed list.
+int cpulist_parse(const char *list, unsigned char *mask, int max, const char *what) {
+    const char *p = list;
+    int count = 0;
+
+    while (*p && *p != '\n') {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo) return -1;
+            p = end;
+        }
+        for (long cpu = lo; cpu <= hi && cpu < max; cpu++) {
+            if (!mask[cpu]) count++;
+            mask[cpu] = 1;
+        }
+        if (what && hi >= max) {
+            long first = lo > max ? lo : max;
+            if (first == hi) fprintf(stderr, "Skipping %s %ld: no such %s\n", what, hi, what);
+            else fprintf(stderr, "Skipping %s %ld-%ld: no such %s\n", what, first, hi, what);
+        }
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+    }
+    return count;
+}
+
+// Find the L3 (or failing that, the last level) cache of a CPU and return
+// the first CPU of its shared_cpu_list, which identifies the cache domain.
+static int read_llc_id(int cpu) {
+    char path[256];
+    int best_level = 0, id = -1;
+
+    for (int idx = 0; ; idx++) {
+        int level;
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/level", cpu, idx);
+        if (read_int_file(path, &level) != 0) break;
+        if (level < best_level) continue;
+
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        int first;
+        if (read_int_file(path, &first) != 0) continue;
+        best_level = level;
+        id = first;
+    }
+    return id;
+}
+
+// Data and unified caches of a CPU from sysfs, ordered by level.
+// Returns the number of entries written to caches.
+int topo_caches(int cpu, cache_info_t *caches, int max) {
+    char path[256];
+    int count = 0;
+
+    for (int idx = 0; count < max; idx++) {
+        cache_info_t c;
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/level", cpu, idx);
+        if (read_int_file(path, &c.level) != 0) break;
+
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/type", cpu, idx);
+        char *type = read_line_file(path);
+        int skip = !type || strcmp(type, "Instruction") == 0;
+        free(type);
+        if (skip) continue;
+
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/size", cpu, idx);
+        char *size = read_line_file(path);
+        c.size = size ? parse_size(size) : 0;
+        free(size);
+        if (c.size == 0) continue;
+
+        c.shared = 1;
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        char *list = read_line_file(path);
+        int max_cpu = topo_ncpus > 0 ? topo_ncpus : (int)sysconf(_SC_NPROCESSORS_CONF);
+        unsigned char *mask = calloc(max_cpu, 1);
+        if (list && mask) {
+            int n = cpulist_parse(list, mask, max_cpu, NULL);
+            if (n > 0) c.shared = n;
+        }
+        free(mask);
+        free(list);
+
+        int k = count++;
+        while (k > 0 && caches[k - 1].level > c.level) {
+            caches[k] = caches[k - 1];
+            k--;
+        }
+        caches[k] = c;
+    }
+    return count;
+}
+
+// Fill in the node of every CPU from /sys/devices/system/node/nodeN/cpulist
+static void read_numa_nodes(void) {
+    DIR *dir = opendir(SYSFS_NODE);
+    if (!dir) return;
+    unsigned char *mask = malloc(topo_ncpus);
+    if (!mask) { closedir(dir); return; }
+
+    struct dirent *ent;
+    char path[512];
+    while ((ent = readdir(dir)) != NULL) {
+        int node;
+        if (sscanf(ent->d_name, "node%d", &node) != 1) continue;
+
+        snprintf(path, sizeof(path), SYSFS_NODE "/%s/cpulist", ent->d_name);
+        char *list = read_line_file(path);
+        if (!list) continue;
+        memset(mask, 0, topo_ncpus);
+        if (cpulist_parse(list, mask, topo_ncpus, NULL) > 0) {
+            for (int cpu = 0; cpu < topo_ncpus; cpu++) {
+                if (mask[cpu]) topo[cpu].node = node;
+            }
+        }
+        free(list);
+    }
+    free(mask);
+    closedir(dir);
+}
+
+int topo_init(void) {
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    if (n <= 0) return -1;
+
+    topo = calloc(n, sizeof(*topo));
+    if (!topo) return -1;
+    topo_ncpus = n;
+
+    char path[256];
+    for (int cpu = 0; cpu < n; cpu++) {
+        cpu_topo_t *t = &topo[cpu];
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/physical_package_id", cpu);
+        if (read_int_file(path, &t->package) != 0) t->package = -1;
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/die_id", cpu);
+        if (read_int_file(path, &t->die) != 0) t->die = -1;
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/core_id", cpu);
+        if (read_int_file(path, &t->core) != 0) t->core = -1;
+        t->l3 = read_llc_id(cpu);
+        t->node = -1;
+    }
+    read_numa_nodes();
+    return 0;
+}
+
+const cpu_topo_t *topo_cpu(int cpu) {
+    static const cpu_topo_t unknown = {-1, -1, -1, -1, -1};
+    if (!topo || cpu < 0 || cpu >= topo_ncpus) return &unknown;
+    return &topo[cpu];
+}
+
+// Domain id of a CPU for the given isolation level. CPUs with unknown
+// topology each get a domain of their own so they never block scheduling.
+int topo_domain(int cpu, isolate_t isolate) {
+    const cpu_topo_t *t = topo_cpu(cpu);
+    int id = -1;
+    switch (isolate) {
+        case ISOLATE_SOCKET: id = t->package; break;
+        case ISOLATE_L3:     id = t->l3; break;
+        default:             break;
+    }
+    return id >= 0 ? id : -(cpu + 2);
+}
+
+// Classify a CPU pair. Unknown fields never match, so missing topology
+// degrades to the most distant tier rather than claiming proximity.
+tier_t topo_tier(int a, int b) {
+    const cpu_topo_t *ta = topo_cpu(a), *tb = topo_cpu(b);
+    int same_pkg = ta->package >= 0 && ta->package == tb->package;
+
+    if (same_pkg && ta->core >= 0 && ta->core == tb->core && ta->die == tb->die) {
+        return TIER_SMT;
+    }
+    if (ta->l3 >= 0 && ta->l3 == tb->l3) return TIER_L3;
+    if (same_pkg) return TIER_SOCKET;
+    return TIER_CROSS_SOCKET;
+}
+
+const char *tier_name(tier_t tier) {
+    return tier < NUM_TIERS ? tier_names[tier] : "unknown";
+}
+
+static int topo_cmp(const void *pa, const void *pb) {
+    int a = *(const int *)pa, b = *(const int *)pb;
+    const cpu_topo_t *ta = topo_cpu(a), *tb = topo_cpu(b);
+    if (ta->package != tb->package) return ta->package - tb->package;
+    if (ta->die != tb->die) return ta->die - tb->die;
+    if (ta->l3 != tb->l3) return ta->l3 - tb->l3;
+    if (ta->core != tb->core) return ta->core - tb->core;
+    return a - b;       // SMT siblings in CPU id order
+}
+
+// Order CPUs by package -> die -> L3 domain -> core -> SMT sibling
+void topo_sort(int *cpus, int n) {
+    qsort(cpus, n, sizeof(int), topo_cmp);
+}
+
+// Print the topology of the given CPUs plus the socket/core/thread counts
+// that cpudetect.py used to scrape from lscpu.
+void topo_print(const int *cpus, int n) {
+    int packages = 0, cores = 0, l3s = 0;
+
+    printf("  CPU  Node  Package  Die    L3  Core\n");
+    for (int i = 0; i < n; i++) {
+        const cpu_topo_t *t = topo_cpu(cpus[i]);
+        printf("%5d %5d %8d %4d %5d %5d\n", cpus[i], t->node, t->package, t->die, t->l3, t->core);
+
+        // cpus[] is topology sorted, so new groups show up as changes
+        const cpu_topo_t *p = i > 0 ? topo_cpu(cpus[i - 1]) : NULL;
+        if (!p || p->package != t->package) packages++;
+        if (!p || p->package != t->package || p->l3 != t->l3) l3s++;
+        if (!p || topo_tier(cpus[i - 1], cpus[i]) != TIER_SMT) cores++;
+    }
+    printf("Sockets: %d, L3 domains: %d, cores: %d, threads per core: %d\n",
+           packages, l3s, cores, cores ? n / cores : 0);
+}
+
+// CPUs the benchmark may run on, set by cpuset_build()
+static unsigned char *usable;
+static int usable_max;
+
+// Build the sorted list of usable CPUs: online (per
+// /sys/devices/system/cpu/online), inside this process's affinity mask
+// (cgroup cpusets, taskset) and, if cpulist is given, in that list.
+// CPUs requested but not usable are reported and skipped.
+// Returns the number of CPUs, or -1 on error.
+int cpuset_build(const char *cpulist, int **cpus) {
+    int max = topo_ncpus > 0 ? topo_ncpus : (int)sysconf(_SC_NPROCESSORS_CONF);
+    unsigned char *online = calloc(max, 1);
+    unsigned char *requested = calloc(max, 1);
+    usable = calloc(max, 1);
+    usable_max = max;
+    *cpus = malloc(max * sizeof(int));
+    if (!online || !requested || !usable || !*cpus) { perror("malloc"); exit(1); }
+
+    char *list = read_line_file(SYSFS_CPU "/online");
+    if (!list || cpulist_parse(list, online, max, NULL) <= 0) {
+        // No sysfs: trust the affinity mask alone
+        memset(online, 1, max);
+    }
+    free(list);
+
+    cpu_set_t *affinity = CPU_ALLOC(max);
+    size_t setsize = CPU_ALLOC_SIZE(max);
+    if (!affinity || sched_getaffinity(0, setsize, affinity) != 0) {
+        perror("sched_getaffinity");
+        exit(1);
+    }
+
+    if (cpulist) {
+        if (cpulist_parse(cpulist, requested, max, "CPU") < 0) {
+            fprintf(stderr, "Invalid CPU list '%s'\n", cpulist);
+            return -1;
+        }
+    } else {
+        memset(requested, 1, max);
+    }
+
+    int n = 0;
+    for (int cpu = 0; cpu < max; cpu++) {
+        if (!requested[cpu]) continue;
+        if (!online[cpu] || !CPU_ISSET_S(cpu, setsize, affinity)) {
+            if (cpulist) {
+                fprintf(stderr, "Skipping CPU %d: %s\n", cpu,
+                        online[cpu] ? "not in the affinity mask" : "offline");
+            }
+            continue;
+        }
+        usable[cpu] = 1;
+        (*cpus)[n++] = cpu;
+    }
+
+    CPU_FREE(affinity);
+    free(online);
+    free(requested);
+    return n;
+}
+
+int cpuset_contains(int cpu) {
+    return usable && cpu >= 0 && cpu < usable_max && usable[cpu];
+}
@@ -0,0 +1,68 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <time.h>
+
+#define CALIBRATION_NS 100000000ULL   // 100 ms against CLOCK_MONOTONIC_RAW
+#define CALIBRATION_PROBES 5
+
+double tsc_hz;
+
+// Returns 1 if /proc/cpuinfo advertises an invariant TSC (constant rate
+// and not stopped in deep C-states), 0 if not, -1 if the flags are unreadable.
+int tsc_invariant(void) {
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) return -1;
+
+    char *line = NULL;
+    size_t cap = 0;
+    int constant = 0, nonstop = 0, found = 0;
+    while (getline(&line, &cap, f) > 0) {
+        if (strncmp(line, "flags", 5) != 0) continue;
+        found = 1;
+        for (char *tok = strtok(line, " \t\n"); tok; tok = strtok(NULL, " \t\n")) {
+            if (strcmp(tok, "constant_tsc") == 0) constant = 1;
+            if (strcmp(tok, "nonstop_tsc") == 0) nonstop = 1;
+        }
+        break;
+    }
+    free(line);
+    fclose(f);
+    if (!found) return -1;
+    return constant && nonstop;
+}
+
+static uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Take a (clock, tsc) pair, keeping the probe with the tightest clock
+// bracket so a preemption between the reads does not skew the result.
+static void paired_read(uint64_t *ns, uint64_t *tsc) {
+    uint64_t best = UINT64_MAX;
+    *ns = *tsc = 0;
+    for (int i = 0; i < CALIBRATION_PROBES; i++) {
+        uint64_t c0 = clock_ns();
+        uint64_t t = rdtsc_end();
+        uint64_t c1 = clock_ns();
+        if (c1 - c0 < best) {
+            best = c1 - c0;
+            *ns = c0 + (c1 - c0) / 2;
+            *tsc = t;
+        }
+    }
+}
+
+// Measure the TSC frequency against CLOCK_MONOTONIC_RAW, which is not
+// slewed by NTP. Sets and returns tsc_hz.
+double tsc_calibrate(void) {
+    uint64_t ns0, tsc0, ns1, tsc1;
+    paired_read(&ns0, &tsc0);
+    struct timespec ts = {0, CALIBRATION_NS};
+    nanosleep(&ts, NULL);
+    paired_read(&ns1, &tsc1);
+
+    tsc_hz = (double)(tsc1 - tsc0) * 1e9 / (double)(ns1 - ns0);
+    return tsc_hz;
+}
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include "c2c_latency.h"
+#include <sys/eventfd.h>
+#include <fcntl.h>
+
+// Blocking wakeup latency between two cores.
+// Like the ping-pong, but each side sleeps until the other wakes it: the
+// leader posts the follower and waits to be posted back, so one sample is
+// two wakeups (reported halved). A waiter may first spin for spin_cycles
+// on its channel's state word and only blocks if nothing arrived by then.
+// The waker only goes through the kernel if the waiter is really asleep:
+//
+//   state: IDLE -> (waiter gives up spinning) SLEEPING -> (waker) POSTED
+//          IDLE -> (waker, waiter still spinning) POSTED
+//
+// and the waiter resets POSTED to IDLE once it has woken up.
+
+#define WAKE_ITERATIONS (ITERATIONS / 50 > 10 ? ITERATIONS / 50 : 10)
+#define WAKE_WARMUP (WAKE_ITERATIONS / 10)
+
+enum { WAKE_IDLE, WAKE_SLEEPING, WAKE_POSTED };
+
+static const char *wake_names[NUM_WAKE_TYPES] = {"futex", "eventfd", "pipe", "condvar"};
+static const char *wake_desc[NUM_WAKE_TYPES] = {
+    "futex wake", "eventfd write/read", "pipe write/read", "pthread_cond_signal"
+};
+
+typedef struct {
+    volatile uint32_t state;
+    int fd[2];              // eventfd: fd[0]; pipe: read end, write end
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} __attribute__((aligned(CACHE_LINE_SIZE))) wake_chan_t;
+
+typedef struct {
+    pool_job_t job;
+    wake_cfg_t cfg;
+    wake_chan_t *chan;      // [0] leader's, [1] follower's
+    pair_result_t *res;
+} wake_job_t;
+
+int wake_type_parse(const char *name) {
+    for (int i = 0; i < NUM_WAKE_TYPES; i++) {
+        if (strcmp(name, wake_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char *wake_type_name(wake_type_t type) {
+    return wake_desc[type];
+}
+
+static int chan_init(wake_chan_t *c, wake_type_t type) {
+    memset(c, 0, sizeof(*c));
+    c->fd[0] = c->fd[1] = -1;
+    switch (type) {
+        case WAKE_EVENTFD:
+            c->fd[0] = eventfd(0, EFD_CLOEXEC);
+            if (c->fd[0] < 0) { perror("eventfd"); return -1; }
+            break;
+        case WAKE_PIPE:
+            if (pipe2(c->fd, O_CLOEXEC) != 0) { perror("pipe"); return -1; }
+            break;
+        case WAKE_CONDVAR:
+            pthread_mutex_init(&c->mutex, NULL);
+            pthread_cond_init(&c->cond, NULL);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void chan_destroy(wake_chan_t *c, wake_type_t type) {
+    if (c->fd[0] >= 0) close(c->fd[0]);
+    if (c->fd[1] >= 0) close(c->fd[1]);
+    if (type == WAKE_CONDVAR) {
+        pthread_mutex_destroy(&c->mutex);
+        pthread_cond_destroy(&c->cond);
+    }
+}
+
+static void wake_post(wake_chan_t *c, wake_type_t type) {
+    if (__atomic_exchange_n(&c->state, WAKE_POSTED, __ATOMIC_ACQ_REL) != WAKE_SLEEPING) {
+        return;     // waiter still spinning, it will see POSTED
+    }
+    uint64_t one = 1;
+    switch (type) {
+        case WAKE_FUTEX:
+            futex_wake(&c->state, 1);
+            break;
+        case WAKE_EVENTFD:
+            if (write(c->fd[0], &one, sizeof(one)) != sizeof(one)) perror("eventfd write");
+            break;
+        case WAKE_PIPE:
+            if (write(c->fd[1], &one, 1) != 1) perror("pipe write");
+            break;
+        case WAKE_CONDVAR:
+            pthread_mutex_lock(&c->mutex);
+            pthread_cond_signal(&c->cond);
+            pthread_mutex_unlock(&c->mutex);
+            break;
+        default:
+            break;
+    }
+}
+
+static void wake_wait(wake_chan_t *c, wake_type_t type, uint64_t spin_cycles) {
+    if (spin_cycles) {
+        uint64_t deadline = rdtsc() + spin_cycles;
+        while (c->state != WAKE_POSTED && rdtsc() < deadline) cpu_relax();
+    }
+    uint32_t expected = WAKE_IDLE;
+    if (__atomic_compare_exchange_n(&c->state, &expected, WAKE_SLEEPING, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        uint64_t buf;
+        switch (type) {
+            case WAKE_FUTEX:
+                while (__atomic_load_n(&c->state, __ATOMIC_ACQUIRE) == WAKE_SLEEPING) {
+                    futex_wait(&c->state, WAKE_SLEEPING);
+                }
+                break;
+            case WAKE_EVENTFD:
+                while (read(c->fd[0], &buf, sizeof(buf)) < 0 && errno == EINTR) {}
+                break;
+            case WAKE_PIPE:
+                while (read(c->fd[0], &buf, 1) < 0 && errno == EINTR) {}
+                break;
+            case WAKE_CONDVAR:
+                pthread_mutex_lock(&c->mutex);
+                while (c->state == WAKE_SLEEPING) pthread_cond_wait(&c->cond, &c->mutex);
+                pthread_mutex_unlock(&c->mutex);
+                break;
+            default:
+                break;
+        }
+    }
+    __atomic_store_n(&c->state, WAKE_IDLE, __ATOMIC_RELEASE);
+}
+
+static void wake_job(pool_job_t *job, int role) {
+    wake_job_t *wj = (wake_job_t *)job;
+    wake_type_t type = wj->cfg.type;
+    uint64_t spin = wj->cfg.spin_cycles;
+    wake_chan_t *mine = &wj->chan[role], *peer = &wj->chan[role ^ 1];
+
+    job_sync(job);
+    for (int i = 0; i < WAKE_WARMUP + WAKE_ITERATIONS; i++) {
+        if (role == 0) {
+            uint64_t start = rdtsc_start();
+            wake_post(peer, type);
+            wake_wait(mine, type, spin);
+            uint64_t end = rdtsc_end();
+            if (i >= WAKE_WARMUP) hist_record(&wj->res->hist, end - start);
+        } else {
+            wake_wait(mine, type, spin);
+            wake_post(peer, type);
+        }
+    }
+}
+
+static int wake_start(wake_job_t *wj, const wake_cfg_t *cfg, int cpu1, int cpu2,
+                      pair_result_t *res) {
+    wj->chan = aligned_alloc(CACHE_LINE_SIZE, 2 * sizeof(wake_chan_t));
+    if (!wj->chan) { perror("malloc"); exit(1); }
+    if (chan_init(&wj->chan[0], cfg->type) != 0 || chan_init(&wj->chan[1], cfg->type) != 0) {
+        exit(1);
+    }
+    hist_init(&res->hist);
+    wj->cfg = *cfg;
+    wj->res = res;
+    wj->job.fn = wake_job;
+    wj->job.nthreads = 2;
+    int cpus[2] = {cpu1, cpu2};
+    if (pool_dispatch(&wj->job, cpus) != 0) {
+        chan_destroy(&wj->chan[0], cfg->type);
+        chan_destroy(&wj->chan[1], cfg->type);
+        free(wj->chan);
+        wj->chan = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void wake_finish(wake_job_t *wj) {
+    if (!wj->chan) return;
+    pool_wait(&wj->job);
+    chan_destroy(&wj->chan[0], wj->cfg.type);
+    chan_destroy(&wj->chan[1], wj->cfg.type);
+    free(wj->chan);
+    wj->chan = NULL;
+}
+
+int run_wakeup(const wake_cfg_t *cfg, int cpu1, int cpu2, pair_result_t *res) {
+    wake_job_t wj;
+    if (wake_start(&wj, cfg, cpu1, cpu2, res) != 0) return -1;
+    wake_finish(&wj);
+    return 0;
+}
+
+// Batch runner for run_matrix_parallel(); arg points at the wake_cfg_t
+void wake_batch(pair_job_t *jobs, int count, void *arg) {
+    const wake_cfg_t *cfg = arg;
+    wake_job_t *wj = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(wake_job_t));
+    if (!wj) { perror("malloc"); exit(1); }
+    for (int dir = 0; dir < 2; dir++) {
+        for (int k = 0; k < count; k++) {
+            if (dir == 0) wake_start(&wj[k], cfg, jobs[k].a, jobs[k].b, jobs[k].res_ab);
+            else if (jobs[k].res_ba) wake_start(&wj[k], cfg, jobs[k].b, jobs[k].a, jobs[k].res_ba);
+            else wj[k].chan = NULL;
+        }
+        for (int k = 0; k < count; k++) {
+            wake_finish(&wj[k]);
+        }
+    }
+    free(wj);
+}